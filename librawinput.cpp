@@ -16,18 +16,26 @@
 #endif
 
 #include "librawinput.h"
+#include "librawinput_internal.h"
 
 #include <Windows.h>
 #include <hidusage.h>
 #include <hidsdi.h>
 #include <hidpi.h>
+#include <avrt.h>
 
 #include <cstddef>
 #include <cstdint>
 #include <cassert>
+#include <cmath>
+#include <cwctype>
+#include <algorithm>
+#include <limits>
 #include <memory>
+#include <utility>
 #include <chrono>
 #include <string>
+#include <string_view>
 #include <array>
 #include <vector>
 #include <unordered_map>
@@ -36,8 +44,14 @@
 #include <functional>
 #include <thread>
 #include <future>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 #pragma comment(lib, "hid.lib")
+#pragma comment(lib, "avrt.lib")
+#pragma comment(lib, "Synchronization.lib")
 
 namespace ttsuki::librawinput
 {
@@ -47,31 +61,54 @@ namespace ttsuki::librawinput
     public:
         using WndProc = std::function<std::optional<LRESULT>(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)>;
 
+        struct MessageLoopStatistics
+        {
+            std::atomic<uint64_t> SpinCount{};
+            std::atomic<uint64_t> YieldCount{};
+            std::atomic<uint64_t> BlockingWaitCount{};
+        };
+
     private:
         WndProc window_proc_{};
         std::thread thread_{};
         DWORD thread_id_{};
         HWND window_{};
+        std::shared_future<void> ready_{};
+        TIMESTAMP start_time_{};
+        MessageLoopStatistics statistics_{};
 
     public:
-        [[nodiscard]] DWORD ThreadId() const { return thread_id_; }
-        [[nodiscard]] HWND Window() const { return window_; }
+        /// Waits until the thread has created the window.
+        void WaitForReady() const { ready_.wait(); }
 
-        ThreadedMessageWindow(LPCSTR lpClassName, LPCSTR lpWindowName, WndProc wnd_proc)
-            : window_proc_(std::move(wnd_proc))
+        [[nodiscard]] DWORD ThreadId() const { return WaitForReady(), thread_id_; }
+        [[nodiscard]] HWND Window() const { return WaitForReady(), window_; }
+        [[nodiscard]] TIMESTAMP StartTime() const { return start_time_; }
+        [[nodiscard]] const MessageLoopStatistics& Statistics() const { return statistics_; }
+
+        /// Gets CPU time (user + kernel) consumed by the thread in microseconds.
+        [[nodiscard]] TIMESTAMP ThreadCpuTime()
         {
-            struct SubThreadData
-            {
-                DWORD thread_id{};
-                HWND window{};
-            };
+            FILETIME creation{}, exit{}, kernel{}, user{};
+            if (!::GetThreadTimes(thread_.native_handle(), &creation, &exit, &kernel, &user))
+                return 0;
+
+            const auto to_100ns = [](const FILETIME& t) { return static_cast<TIMESTAMP>(static_cast<uint64_t>(t.dwHighDateTime) << 32 | t.dwLowDateTime); };
+            return (to_100ns(kernel) + to_100ns(user)) / 10;
+        }
 
-            std::promise<SubThreadData> promise;
-            std::future<SubThreadData> future = promise.get_future();
+        /// Starts the thread without waiting for it.
+        /// @param on_start called on the thread after the window is created, before the message loop runs.
+        ThreadedMessageWindow(LPCSTR lpClassName, LPCSTR lpWindowName, WndProc wnd_proc, std::function<void(HWND hWnd)> on_start = {}, RawInputThreadOptions thread_options = {})
+            : window_proc_(std::move(wnd_proc))
+            , start_time_(Clock())
+        {
+            std::promise<void> promise;
+            ready_ = promise.get_future().share();
 
-            thread_ = std::thread([this, ready = std::move(promise), lpClassName, lpWindowName]() mutable
+            thread_ = std::thread([this, ready = std::move(promise), lpClassName, lpWindowName, on_start = std::move(on_start), thread_options = std::move(thread_options)]() mutable
             {
-                (void)::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+                auto thread_settings = ApplyThreadOptions(thread_options);
 
                 auto create_param = this;
                 auto wnd_class = RegisterMessageWindowClass(lpClassName, NativeWndProc);
@@ -82,26 +119,24 @@ namespace ttsuki::librawinput
                 ::PeekMessageA(&msg, nullptr, 0, 0, PM_NOREMOVE);
 
                 // Notifies ready to parent thread.
-                ready.set_value(SubThreadData{::GetCurrentThreadId(), wnd_handle.get()});
+                this->thread_id_ = ::GetCurrentThreadId();
+                this->window_ = wnd_handle.get();
+                ready.set_value();
+
+                if (on_start)
+                    on_start(wnd_handle.get());
 
                 // Run message loop.
-                while (::GetMessageA(&msg, nullptr, 0, 0))
-                {
-                    ::DispatchMessageA(&msg);
-                }
+                if (thread_options.BusyPoll)
+                    RunBusyPollMessageLoop(thread_options, statistics_);
+                else
+                    RunMessageLoop();
             });
-
-            // Waits for ready.
-            {
-                const SubThreadData ready = future.get();
-                this->thread_id_ = ready.thread_id;
-                this->window_ = ready.window;
-            }
         }
 
         ~ThreadedMessageWindow()
         {
-            ::PostThreadMessageA(thread_id_, WM_QUIT, 0, 0); // exit message loop
+            ::PostThreadMessageA(ThreadId(), WM_QUIT, 0, 0); // exit message loop
             thread_.join();
         }
 
@@ -112,15 +147,110 @@ namespace ttsuki::librawinput
 
         LRESULT SendMessageToWindow(UINT msg, WPARAM wParam, LPARAM lParam)
         {
-            return ::SendMessageA(window_, msg, wParam, lParam);
+            return ::SendMessageA(Window(), msg, wParam, lParam);
         }
 
         BOOL PostMessageToWindow(UINT msg, WPARAM wParam, LPARAM lParam)
         {
-            return ::PostMessageA(window_, msg, wParam, lParam);
+            return ::PostMessageA(Window(), msg, wParam, lParam);
         }
 
     protected:
+        static void RunMessageLoop()
+        {
+            MSG msg{};
+            while (::GetMessageA(&msg, nullptr, 0, 0))
+            {
+                ::DispatchMessageA(&msg);
+            }
+        }
+
+        /// Spins, then yields, then backs off to blocking wait while no message arrives.
+        static void RunBusyPollMessageLoop(const RawInputThreadOptions& options, MessageLoopStatistics& statistics)
+        {
+            // Count of pause instructions per spin round.
+            constexpr int kSpinPauseCount = 16;
+
+            MSG msg{};
+            TIMESTAMP last_message_time = Clock();
+            while (true)
+            {
+                if (::PeekMessageA(&msg, nullptr, 0, 0, PM_REMOVE))
+                {
+                    if (msg.message == WM_QUIT)
+                        break;
+
+                    ::DispatchMessageA(&msg);
+                    last_message_time = Clock();
+                    continue;
+                }
+
+                const TIMESTAMP idle_time = Clock() - last_message_time;
+                if (idle_time < options.BusyPollSpinTime)
+                {
+                    for (int i = 0; i < kSpinPauseCount; i++) YieldProcessor();
+                    statistics.SpinCount.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                if (idle_time < options.BusyPollSpinTime + options.BusyPollYieldTime)
+                {
+                    ::SwitchToThread();
+                    statistics.YieldCount.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                statistics.BlockingWaitCount.fetch_add(1, std::memory_order_relaxed);
+                (void)::MsgWaitForMultipleObjectsEx(0, nullptr, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+                // Spins again after wake up.
+                last_message_time = Clock();
+            }
+        }
+
+        static std::shared_ptr<void> ApplyThreadOptions(const RawInputThreadOptions& options)
+        {
+            const HANDLE thread = ::GetCurrentThread();
+
+            if (!options.Name.empty())
+            {
+                // SetThreadDescription is available on Windows 10 1607 or later.
+                using SetThreadDescriptionProc = HRESULT(WINAPI*)(HANDLE hThread, PCWSTR lpThreadDescription);
+                if (auto proc = reinterpret_cast<SetThreadDescriptionProc>(::GetProcAddress(::GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription")))
+                    (void)proc(thread, options.Name.c_str());
+            }
+
+            if (options.AffinityMask != 0)
+            {
+                if (!::SetThreadAffinityMask(thread, static_cast<DWORD_PTR>(options.AffinityMask)))
+                {
+                    ::OutputDebugStringA("Failed to SetThreadAffinityMask(...)\n");
+                    if (::IsDebuggerPresent()) ::DebugBreak();
+                }
+            }
+
+            if (!::SetThreadPriority(thread, options.Priority))
+            {
+                ::OutputDebugStringA("Failed to SetThreadPriority(...)\n");
+                if (::IsDebuggerPresent()) ::DebugBreak();
+            }
+
+            if (!options.MmcssTaskName.empty())
+            {
+                DWORD task_index = 0;
+                if (HANDLE task = ::AvSetMmThreadCharacteristicsW(options.MmcssTaskName.c_str(), &task_index))
+                {
+                    (void)::AvSetMmThreadPriority(task, static_cast<AVRT_PRIORITY>(options.MmcssPriority));
+                    return {task, ::AvRevertMmThreadCharacteristics};
+                }
+
+                ::OutputDebugStringA("Failed to AvSetMmThreadCharacteristics(...)\n");
+                if (::IsDebuggerPresent()) ::DebugBreak();
+            }
+
+            return {};
+        }
+
         static std::shared_ptr<std::remove_pointer_t<LPCSTR>> RegisterMessageWindowClass(LPCSTR lpClassName, WNDPROC pfnWndProc)
         {
             WNDCLASSEXA wcx = {sizeof(WNDCLASSEXA)};
@@ -217,6 +347,13 @@ namespace ttsuki::librawinput
                     ret == RAW_INPUT_ERROR)
                     continue;
 
+                if (device_info.dwType == RIM_TYPEHID)
+                {
+                    dev.VendorId = static_cast<uint16_t>(device_info.hid.dwVendorId);
+                    dev.ProductId = static_cast<uint16_t>(device_info.hid.dwProductId);
+                    dev.VersionNumber = static_cast<uint16_t>(device_info.hid.dwVersionNumber);
+                }
+
                 if (device_info.dwType == RIM_TYPEMOUSE)
                 {
                     dev.Type = RawInputDeviceType::Mouse;
@@ -233,6 +370,18 @@ namespace ttsuki::librawinput
                 {
                     dev.Type = RawInputDeviceType::GamePad;
                 }
+                else if (device_info.dwType == RIM_TYPEHID && (device_info.hid.usUsagePage == HID_USAGE_PAGE_GENERIC && device_info.hid.usUsage == HID_USAGE_GENERIC_MULTI_AXIS_CONTROLLER))
+                {
+                    dev.Type = RawInputDeviceType::MultiAxis;
+                }
+                else if (device_info.dwType == RIM_TYPEHID && device_info.hid.usUsagePage == HID_USAGE_PAGE_DIGITIZER)
+                {
+                    dev.Type = RawInputDeviceType::Digitizer;
+                }
+                else if (device_info.dwType == RIM_TYPEHID && (device_info.hid.usUsagePage == HID_USAGE_PAGE_CONSUMER && device_info.hid.usUsage == HID_USAGE_CONSUMERCTRL))
+                {
+                    dev.Type = RawInputDeviceType::ConsumerControl;
+                }
                 else if (device_info.dwType == RIM_TYPEHID)
                 {
                     dev.Type = RawInputDeviceType::Other;
@@ -269,184 +418,2639 @@ namespace ttsuki::librawinput
         return result;
     }
 
-    struct HidDeviceCaps
+    /// Role of a HID value in joystick events.
+    struct JoystickValueRole
     {
-        HANDLE DeviceHandle{};
-        HIDP_CAPS HidPCaps{};
-        std::unique_ptr<std::byte[]> PreparsedDataBlob{};
-        std::vector<HIDP_VALUE_CAPS> ValueCaps{};
-        std::vector<HIDP_BUTTON_CAPS> ButtonCaps{};
-        [[nodiscard]] PHIDP_PREPARSED_DATA PreparsedData() const noexcept { return reinterpret_cast<PHIDP_PREPARSED_DATA>(PreparsedDataBlob.get()); }
+        enum struct RoleKind : uint8_t
+        {
+            None,
+            Axis,      // signed, to JoystickAxis Index
+            Throttle,  // unsigned, to JoystickAxis Index; absent when out of range
+            HatSwitch, // unsigned, to hat switch Index
+        };
 
-        static std::unique_ptr<HidDeviceCaps> FromDevice(HANDLE device);
+        RoleKind Kind{};
+        uint8_t Index{};
+
+        /// Classifies a value by its usage. Sliders and hat switches are numbered in order of appearance.
+        static JoystickValueRole Classify(uint16_t page, uint16_t usage, int& slider_count, int& hat_switch_count)
+        {
+            const auto axis = [](JoystickAxis a) { return JoystickValueRole{RoleKind::Axis, static_cast<uint8_t>(a)}; };
+            const auto throttle = [](JoystickAxis a) { return JoystickValueRole{RoleKind::Throttle, static_cast<uint8_t>(a)}; };
+            const auto hat_switch = [](int index) { return JoystickValueRole{RoleKind::HatSwitch, static_cast<uint8_t>(index)}; };
+
+            if (page == HID_USAGE_PAGE_GENERIC)
+            {
+                switch (usage)
+                {
+                case HID_USAGE_GENERIC_X: return axis(JoystickAxis::X);
+                case HID_USAGE_GENERIC_Y: return axis(JoystickAxis::Y);
+                case HID_USAGE_GENERIC_Z: return axis(JoystickAxis::Z);
+                case HID_USAGE_GENERIC_RX: return axis(JoystickAxis::RotX);
+                case HID_USAGE_GENERIC_RY: return axis(JoystickAxis::RotY);
+                case HID_USAGE_GENERIC_RZ: return axis(JoystickAxis::RotZ);
+                case HID_USAGE_GENERIC_SLIDER:
+                    if (int i = slider_count++; i < 4) return throttle(static_cast<JoystickAxis>(static_cast<uint32_t>(JoystickAxis::Slider0) + i));
+                    return {};
+                case HID_USAGE_GENERIC_HATSWITCH:
+                    if (int i = hat_switch_count++; i < 2) return hat_switch(i);
+                    return {};
+                default: // ignore value
+                    return {};
+                }
+            }
+
+            if (page == HID_USAGE_PAGE_SIMULATION)
+            {
+                switch (usage)
+                {
+                case HID_USAGE_SIMULATION_STEERING: return axis(JoystickAxis::X);
+                case HID_USAGE_SIMULATION_ACCELLERATOR: return axis(JoystickAxis::Y);
+                case HID_USAGE_SIMULATION_BRAKE: return axis(JoystickAxis::Z);
+                case HID_USAGE_SIMULATION_RUDDER: return axis(JoystickAxis::RotZ);
+                case HID_USAGE_SIMULATION_THROTTLE: return throttle(JoystickAxis::Slider0);
+                default: return {};
+                }
+            }
+
+            if (page == HID_USAGE_PAGE_GAME)
+            {
+                switch (usage)
+                {
+                case HID_USAGE_GAME_POINT_OF_VIEW: return hat_switch(0);
+                default: return {};
+                }
+            }
+
+            return {};
+        }
     };
 
-    class RawInputEventListenerImpl final
+    /// Joystick conversion of a value cap with precomputed 16.16 fixed-point scale factors.
+    struct JoystickAxisLayout
     {
-        static inline constexpr UINT WM_REGISTER_DEVICE = WM_APP + 1;
+        static inline constexpr size_t kHatSwitchTableSize = 16;
 
-        RawInputDeviceType target_device_types_{};
-        RawInputCallbacks callbacks_{};
-        std::unique_ptr<ThreadedMessageWindow> message_window_{};
-        std::unordered_map<HANDLE, std::unique_ptr<HidDeviceCaps>> preparsed_data_cache_{};
+        JoystickValueRole Role{};
+        int32_t Min{};
+        int64_t Range{}; // Max - Min. <= 0: the value is unusable.
+        int64_t Scale{}; // output units per Range, in 16.16
+        int64_t HatSwitchIndexScale{}; // table index per Range, in 16.16
+        std::array<std::array<int16_t, 2>, kHatSwitchTableSize> HatSwitchXY{}; // signed X/Y of each hat switch position
 
-    public:
-        RawInputEventListenerImpl(RawInputDeviceType target_device_types, RawInputCallbacks callbacks)
-            : target_device_types_(target_device_types)
-            , callbacks_(std::move(callbacks))
-            , message_window_(std::make_unique<ThreadedMessageWindow>(
-                  "CLSRawInputEventListener",
-                  "WNDRawInputEventListener",
-                  [this]([[maybe_unused]] HWND hWnd,
-                         [[maybe_unused]] UINT uMsg,
-                         [[maybe_unused]] WPARAM wParam,
-                         [[maybe_unused]] LPARAM lParam) -> std::optional<LRESULT>
-                  {
-                      switch (uMsg)
-                      {
-                      case WM_REGISTER_DEVICE: return this->RegisterDevices(static_cast<DWORD>(wParam), reinterpret_cast<HWND>(lParam));
-                      case WM_INPUT: return this->ProcessWMInput(reinterpret_cast<HRAWINPUT>(lParam));
-                      default: return std::nullopt;
-                      }
-                  }))
+        static JoystickAxisLayout FromValueCap(const HIDP_VALUE_CAPS& cap, JoystickValueRole role)
         {
-            auto list = GetRawInputDeviceList(target_device_types);
-            for (const auto& desc : list)
-                preparsed_data_cache_[desc.Handle] = HidDeviceCaps::FromDevice(desc.Handle);
+            JoystickAxisLayout r{role};
+            r.Min = static_cast<int32_t>(cap.LogicalMin);
+            r.Range = static_cast<int64_t>(cap.LogicalMax) - static_cast<int64_t>(cap.LogicalMin);
+            if (r.Range <= 0) return r;
+
+            // rounded up so that the full range reaches exactly the maximum output.
+            const auto scale = [&r](int64_t one) { return ((one << 16) + r.Range - 1) / r.Range; };
+
+            switch (role.Kind)
+            {
+            case JoystickValueRole::RoleKind::Axis:
+                r.Scale = scale(FixedJoystickHidEvent::kSignedOne);
+                break;
+
+            case JoystickValueRole::RoleKind::Throttle:
+                r.Scale = scale(FixedJoystickHidEvent::kUnsignedOne);
+                break;
+
+            case JoystickValueRole::RoleKind::HatSwitch:
+            {
+                r.Scale = scale(FixedJoystickHidEvent::kUnsignedOne);
+
+                // Positions of a hat switch are few; X/Y are looked up instead of cos/sin.
+                const int64_t last = std::min<int64_t>(r.Range, kHatSwitchTableSize - 1);
+                r.HatSwitchIndexScale = (last << 16) / r.Range;
+                const double PI2 = std::acos(-1.0) * 2.0;
+                for (int64_t i = 0; i <= last; i++)
+                {
+                    const double h = static_cast<double>(i) / static_cast<double>(last);
+                    r.HatSwitchXY[i][0] = static_cast<int16_t>(std::lround(std::cos(h * PI2) * FixedJoystickHidEvent::kSignedOne));
+                    r.HatSwitchXY[i][1] = static_cast<int16_t>(std::lround(std::sin(h * PI2) * FixedJoystickHidEvent::kSignedOne));
+                }
+                break;
+            }
+
+            default:
+                break;
+            }
 
-            // Starts event listening.
-            message_window_->PostMessageToWindow(WM_REGISTER_DEVICE, RIDEV_INPUTSINK, reinterpret_cast<LPARAM>(message_window_->Window()));
+            return r;
         }
+    };
 
-        ~RawInputEventListenerImpl()
+    /// A value in HID reports with its logical range.
+    struct HidValueField
+    {
+        bool Present{};
+        UCHAR ReportId{}; // 0: the device does not use report IDs
+        USAGE Page{};
+        USAGE Usage{};
+        USHORT LinkCollection{};
+        USHORT BitSize{};
+        int32_t Min{};
+        int32_t Max{};
+
+        static HidValueField FromValueCap(const HIDP_VALUE_CAPS& cap)
         {
-            // Stops event listening.
-            message_window_->PostMessageToWindow(WM_REGISTER_DEVICE, RIDEV_REMOVE, reinterpret_cast<LPARAM>(nullptr));
+            return HidValueField{
+                true, cap.ReportID, cap.UsagePage, cap.NotRange.Usage, cap.LinkCollection, cap.BitSize,
+                static_cast<int32_t>(cap.LogicalMin), static_cast<int32_t>(cap.LogicalMax),
+            };
         }
 
-        RawInputEventListenerImpl(const RawInputEventListenerImpl& other) = delete;
-        RawInputEventListenerImpl(RawInputEventListenerImpl&& other) noexcept = delete;
-        RawInputEventListenerImpl& operator=(const RawInputEventListenerImpl& other) = delete;
-        RawInputEventListenerImpl& operator=(RawInputEventListenerImpl&& other) noexcept = delete;
+        /// true: the report may contain the value.
+        [[nodiscard]] bool InReport(PCHAR report, ULONG report_size) const
+        {
+            return Present && (ReportId == 0 || (report_size > 0 && static_cast<UCHAR>(report[0]) == ReportId));
+        }
 
-    private:
-        LRESULT RegisterDevices(DWORD flags, HWND target)
+        /// Reads the value from a report.
+        /// @returns nullopt: the report does not contain the value.
+        [[nodiscard]] std::optional<int32_t> Read(PHIDP_PREPARSED_DATA preparsed, PCHAR report, ULONG report_size) const
         {
-            ARRAY<RAWINPUTDEVICE, 16> v;
-            using DevType = RawInputDeviceType;
-            if (!!(target_device_types_ & DevType::Other)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_POINTER, flags, target});
-            if (!!(target_device_types_ & DevType::Mouse)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_MOUSE, flags, target});
-            if (!!(target_device_types_ & DevType::Keyboard)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_KEYBOARD, flags, target});
-            if (!!(target_device_types_ & DevType::Joystick)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_JOYSTICK, flags, target});
-            if (!!(target_device_types_ & DevType::GamePad)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_GAMEPAD, flags, target});
-            if (!!(target_device_types_ & DevType::Other)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_KEYPAD, flags, target});
-            if (!!(target_device_types_ & DevType::Other)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_MULTI_AXIS_CONTROLLER, flags, target});
+            ULONG value{};
+            if (!InReport(report, report_size) || ::HidP_GetUsageValue(HidP_Input, Page, LinkCollection, Usage, &value, preparsed, report, report_size) != HIDP_STATUS_SUCCESS)
+                return std::nullopt;
 
-            if (BOOL rel = ::RegisterRawInputDevices(v.data(), static_cast<UINT>(v.size()), sizeof(RAWINPUTDEVICE)); !rel)
-            {
-                ::OutputDebugStringA("Failed to RegisterRawInputDevices(...)");
-                if (::IsDebuggerPresent()) ::DebugBreak();
-                return 1;
-            }
+            // sign extension for signed logical range
+            if (Min < 0 && BitSize > 0 && BitSize < 32 && (value >> (BitSize - 1) & 1))
+                value |= ~0ul << BitSize;
 
-            return 0;
+            return static_cast<int32_t>(value);
         }
 
-        LRESULT ProcessWMInput(HRAWINPUT hRawInput)
+        /// Reads the value normalized to 0.0 to 1.0 by the logical range.
+        [[nodiscard]] std::optional<float> ReadNormalized(PHIDP_PREPARSED_DATA preparsed, PCHAR report, ULONG report_size) const
         {
-            TIMESTAMP now = Clock();
+            if (auto v = Read(preparsed, report, report_size))
+                return Normalize(*v);
+            return std::nullopt;
+        }
 
-            // get input data
-            auto input_data_buffer = [stack_buf = std::array<std::byte, 4096>(), heap_buf = std::unique_ptr<std::byte[]>()](HRAWINPUT hRawInput) mutable -> RAWINPUT*
-            {
-                void* buffer = stack_buf.data();
-                UINT size = static_cast<UINT>(stack_buf.size());
-                UINT result = ::GetRawInputData(hRawInput, RID_INPUT, buffer, &size, sizeof(RAWINPUTHEADER));
+        [[nodiscard]] float Normalize(int32_t v) const
+        {
+            return Max > Min ? std::clamp(static_cast<float>(static_cast<int64_t>(v) - Min) / static_cast<float>(static_cast<int64_t>(Max) - Min), 0.0f, 1.0f) : 0.0f;
+        }
+    };
 
-                // If stack_buf is not enough to store data, allocate heap_buf dynamically.
-                if (result == static_cast<UINT>(-1))
-                {
-                    if (UINT required = 0; ::GetRawInputData(hRawInput, RID_INPUT, nullptr, &required, sizeof(RAWINPUTHEADER)) == 0)
-                    {
-                        heap_buf = std::make_unique<std::byte[]>(required);
-                        buffer = heap_buf.get();
-                        size = required;
-                        result = ::GetRawInputData(hRawInput, RID_INPUT, buffer, &size, sizeof(RAWINPUTHEADER));
-                    }
-                }
+    /// Digitizer page usages (HID Usage Tables 0x0D), some of which are missing in older hidusage.h.
+    enum DigitizerUsage : USAGE
+    {
+        DIGITIZER_USAGE_STYLUS = 0x20,
+        DIGITIZER_USAGE_FINGER = 0x22,
+        DIGITIZER_USAGE_TIP_PRESSURE = 0x30,
+        DIGITIZER_USAGE_IN_RANGE = 0x32,
+        DIGITIZER_USAGE_INVERT = 0x3C,
+        DIGITIZER_USAGE_X_TILT = 0x3D,
+        DIGITIZER_USAGE_Y_TILT = 0x3E,
+        DIGITIZER_USAGE_TIP_SWITCH = 0x42,
+        DIGITIZER_USAGE_BARREL_SWITCH = 0x44,
+        DIGITIZER_USAGE_ERASER = 0x45,
+        DIGITIZER_USAGE_WIDTH = 0x48,
+        DIGITIZER_USAGE_HEIGHT = 0x49,
+        DIGITIZER_USAGE_CONTACT_ID = 0x51,
+        DIGITIZER_USAGE_CONTACT_COUNT = 0x54,
+        DIGITIZER_USAGE_SCAN_TIME = 0x56,
+        DIGITIZER_USAGE_SECONDARY_BARREL_SWITCH = 0x5A,
+    };
 
-                // Failed...?
-                if (result == static_cast<UINT>(-1))
-                {
-                    ::OutputDebugStringA("Failed to GetRawInputData(...)\n");
-                    if (::IsDebuggerPresent()) ::DebugBreak();
-                    return nullptr;
-                }
+    /// Reads a button in a digitizer report.
+    /// @returns nullopt: the report does not contain the button.
+    static std::optional<bool> ReadDigitizerButton(PHIDP_PREPARSED_DATA preparsed, USHORT link_collection, USAGE usage, PCHAR report, ULONG report_size)
+    {
+        USAGE pressed[32]{};
+        ULONG len = static_cast<ULONG>(std::size(pressed));
+        if (::HidP_GetUsages(HidP_Input, HID_USAGE_PAGE_DIGITIZER, link_collection, pressed, &len, preparsed, report, report_size) != HIDP_STATUS_SUCCESS)
+            return std::nullopt;
+        return std::find(pressed, pressed + len, usage) != pressed + len;
+    }
 
-                return static_cast<RAWINPUT*>(buffer);
-            };
+    /// Fields of a finger collection.
+    struct DigitizerContactLayout
+    {
+        USHORT LinkCollection{};
+        HidValueField ContactId{};
+        HidValueField X{};
+        HidValueField Y{};
+        HidValueField Width{};
+        HidValueField Height{};
+        HidValueField Pressure{};
+    };
 
-            RAWINPUT* data = input_data_buffer(hRawInput);
+    /// Fields of a stylus collection.
+    struct DigitizerStylusLayout
+    {
+        USHORT LinkCollection{};
+        HidValueField X{};
+        HidValueField Y{};
+        HidValueField Pressure{};
+        HidValueField TiltX{};
+        HidValueField TiltY{};
+    };
 
-            // Raises input event callback.
+    /// Digitizer fields of a device, located once from the device caps.
+    struct DigitizerLayout
+    {
+        std::vector<DigitizerContactLayout> Contacts{};
+        HidValueField ContactCount{};
+        HidValueField ScanTime{};
+        std::optional<DigitizerStylusLayout> Stylus{};
 
-            if (callbacks_.RawInputEventCallback)
-            {
-                callbacks_.RawInputEventCallback(data, now);
-            }
+        static DigitizerLayout FromValueCaps(const std::vector<HIDP_VALUE_CAPS>& value_caps)
+        {
+            DigitizerLayout r{};
 
-            if (callbacks_.KeyboardEventCallback && data->header.dwType == RIM_TYPEKEYBOARD)
+            const auto contact_of = [&r](USHORT link_collection) -> DigitizerContactLayout&
             {
-                KeyboardEvent e = KeyboardEvent::Parse(data, now);
-                callbacks_.KeyboardEventCallback(e);
-            }
+                for (auto& c : r.Contacts)
+                    if (c.LinkCollection == link_collection)
+                        return c;
+                return r.Contacts.emplace_back(DigitizerContactLayout{link_collection});
+            };
 
-            if (callbacks_.MouseEventCallback && data->header.dwType == RIM_TYPEMOUSE)
+            for (const HIDP_VALUE_CAPS& cap : value_caps)
             {
-                MouseEvent e = MouseEvent::Parse(data, now);
-                callbacks_.MouseEventCallback(e);
-            }
+                if (cap.IsRange) continue;
+                const USAGE page = cap.UsagePage;
+                const USAGE usage = cap.NotRange.Usage;
 
-            if ((callbacks_.HidEventCallback || callbacks_.JoystickHidEventCallback) && data->header.dwType == RIM_TYPEHID)
-            {
-                if (auto it = preparsed_data_cache_.find(data->header.hDevice);
-                    it != preparsed_data_cache_.end() && it->second)
-                {
-                    HidEvent e = HidEvent::Parse(data, now, it->second.get());
-                    if (callbacks_.HidEventCallback)
-                    {
-                        callbacks_.HidEventCallback(e);
-                    }
+                if (page == HID_USAGE_PAGE_DIGITIZER && usage == DIGITIZER_USAGE_CONTACT_COUNT) r.ContactCount = HidValueField::FromValueCap(cap);
+                if (page == HID_USAGE_PAGE_DIGITIZER && usage == DIGITIZER_USAGE_SCAN_TIME) r.ScanTime = HidValueField::FromValueCap(cap);
 
-                    if (callbacks_.JoystickHidEventCallback)
-                    {
-                        JoystickHidEvent r = JoystickHidEvent::FromHidEvent(e);
-                        callbacks_.JoystickHidEventCallback(r);
-                    }
+                if (cap.LinkUsagePage == HID_USAGE_PAGE_DIGITIZER && cap.LinkUsage == DIGITIZER_USAGE_STYLUS)
+                {
+                    if (!r.Stylus) r.Stylus = DigitizerStylusLayout{cap.LinkCollection};
+                    if (r.Stylus->LinkCollection != cap.LinkCollection) continue; // uses the first stylus only
+                    if (page == HID_USAGE_PAGE_GENERIC && usage == HID_USAGE_GENERIC_X) r.Stylus->X = HidValueField::FromValueCap(cap);
+                    if (page == HID_USAGE_PAGE_GENERIC && usage == HID_USAGE_GENERIC_Y) r.Stylus->Y = HidValueField::FromValueCap(cap);
+                    if (page == HID_USAGE_PAGE_DIGITIZER && usage == DIGITIZER_USAGE_TIP_PRESSURE) r.Stylus->Pressure = HidValueField::FromValueCap(cap);
+                    if (page == HID_USAGE_PAGE_DIGITIZER && usage == DIGITIZER_USAGE_X_TILT) r.Stylus->TiltX = HidValueField::FromValueCap(cap);
+                    if (page == HID_USAGE_PAGE_DIGITIZER && usage == DIGITIZER_USAGE_Y_TILT) r.Stylus->TiltY = HidValueField::FromValueCap(cap);
+                    continue;
                 }
+
+                if (cap.LinkUsagePage != HID_USAGE_PAGE_DIGITIZER || cap.LinkUsage != DIGITIZER_USAGE_FINGER) continue;
+                if (page == HID_USAGE_PAGE_DIGITIZER && usage == DIGITIZER_USAGE_CONTACT_ID) contact_of(cap.LinkCollection).ContactId = HidValueField::FromValueCap(cap);
+                if (page == HID_USAGE_PAGE_GENERIC && usage == HID_USAGE_GENERIC_X) contact_of(cap.LinkCollection).X = HidValueField::FromValueCap(cap);
+                if (page == HID_USAGE_PAGE_GENERIC && usage == HID_USAGE_GENERIC_Y) contact_of(cap.LinkCollection).Y = HidValueField::FromValueCap(cap);
+                if (page == HID_USAGE_PAGE_DIGITIZER && usage == DIGITIZER_USAGE_WIDTH) contact_of(cap.LinkCollection).Width = HidValueField::FromValueCap(cap);
+                if (page == HID_USAGE_PAGE_DIGITIZER && usage == DIGITIZER_USAGE_HEIGHT) contact_of(cap.LinkCollection).Height = HidValueField::FromValueCap(cap);
+                if (page == HID_USAGE_PAGE_DIGITIZER && usage == DIGITIZER_USAGE_TIP_PRESSURE) contact_of(cap.LinkCollection).Pressure = HidValueField::FromValueCap(cap);
             }
-            return 0;
+
+            // A finger collection without position is not a contact.
+            r.Contacts.erase(std::remove_if(r.Contacts.begin(), r.Contacts.end(), [](const DigitizerContactLayout& c) { return !c.X.Present || !c.Y.Present; }), r.Contacts.end());
+            if (r.Stylus && (!r.Stylus->X.Present || !r.Stylus->Y.Present)) r.Stylus.reset();
+            return r;
         }
     };
 
-    std::shared_ptr<void> StartRawInput(RawInputDeviceType target_device_types, RawInputCallbacks callbacks)
+    /// Consumer control fields of a device.
+    struct ConsumerControlLayout
     {
-        return std::make_shared<RawInputEventListenerImpl>(target_device_types, callbacks);
-    }
+        bool Present{};
+        ULONG MaxUsageListLength{}; // buttons and selector arrays
+        std::vector<HidValueField> Encoders{}; // relative values
 
-    KeyboardEvent KeyboardEvent::Parse(const RAWINPUT* input, TIMESTAMP timestamp)
-    {
-        KeyboardEvent e{};
-        e.Device = input->header.hDevice;
-        e.Timestamp = timestamp;
-        e.RawKeyboard = input->data.keyboard;
-        return e;
-    }
+        static ConsumerControlLayout FromCaps(const std::vector<HIDP_VALUE_CAPS>& value_caps, PHIDP_PREPARSED_DATA preparsed)
+        {
+            ConsumerControlLayout r{};
+            r.MaxUsageListLength = ::HidP_MaxUsageListLength(HidP_Input, HID_USAGE_PAGE_CONSUMER, preparsed);
+            for (const HIDP_VALUE_CAPS& cap : value_caps)
+                if (cap.UsagePage == HID_USAGE_PAGE_CONSUMER && !cap.IsRange && !cap.IsAbsolute)
+                    r.Encoders.push_back(HidValueField::FromValueCap(cap));
+            r.Present = r.MaxUsageListLength != 0 || !r.Encoders.empty();
+            return r;
+        }
+    };
 
-    MouseEvent MouseEvent::Parse(const RAWINPUT* input, TIMESTAMP timestamp)
+    /// Sensor page data fields of an accelerometer and a gyrometer, with calibration to physical units.
+    struct ImuLayout
     {
-        MouseEvent e{};
-        e.Device = input->header.hDevice;
+        struct Axis
+        {
+            HidValueField Field{};
+            double Scale{};
+            double Offset{};
+
+            static Axis FromValueCap(const HIDP_VALUE_CAPS& cap)
+            {
+                // logical to physical range (same if physical range is not given), then unit exponent.
+                int exponent = static_cast<int>(cap.UnitsExp & 0xF);
+                if (exponent >= 8) exponent -= 16;
+                const double unit = std::pow(10.0, exponent);
+
+                Axis r{HidValueField::FromValueCap(cap), unit, 0.0};
+                if (cap.PhysicalMax != cap.PhysicalMin && cap.LogicalMax != cap.LogicalMin)
+                {
+                    const double k = (static_cast<double>(cap.PhysicalMax) - cap.PhysicalMin) / (static_cast<double>(cap.LogicalMax) - cap.LogicalMin);
+                    r.Scale = k * unit;
+                    r.Offset = (cap.PhysicalMin - cap.LogicalMin * k) * unit;
+                }
+                return r;
+            }
+
+            [[nodiscard]] std::optional<float> Read(PHIDP_PREPARSED_DATA preparsed, PCHAR report, ULONG report_size) const
+            {
+                if (auto v = Field.Read(preparsed, report, report_size))
+                    return static_cast<float>(*v * Scale + Offset);
+                return std::nullopt;
+            }
+        };
+
+        std::array<Axis, 3> Acceleration{};
+        std::array<Axis, 3> AngularVelocity{};
+
+        [[nodiscard]] bool HasAcceleration() const { return Acceleration[0].Field.Present && Acceleration[1].Field.Present && Acceleration[2].Field.Present; }
+        [[nodiscard]] bool HasAngularVelocity() const { return AngularVelocity[0].Field.Present && AngularVelocity[1].Field.Present && AngularVelocity[2].Field.Present; }
+
+        static ImuLayout FromValueCaps(const std::vector<HIDP_VALUE_CAPS>& value_caps)
+        {
+            // Sensor page data fields (HID Usage Tables 0x20). Upper 4 bits of the usage are modifiers.
+            constexpr USAGE SENSOR_DATA_MOTION_ACCELERATION_X = 0x453;
+            constexpr USAGE SENSOR_DATA_MOTION_ANGULAR_VELOCITY_X = 0x457;
+
+            ImuLayout r{};
+            for (const HIDP_VALUE_CAPS& cap : value_caps)
+            {
+                if (cap.UsagePage != HID_USAGE_PAGE_SENSOR || cap.IsRange) continue;
+                const USAGE usage = cap.NotRange.Usage & 0x0FFF;
+                if (usage >= SENSOR_DATA_MOTION_ACCELERATION_X && usage < SENSOR_DATA_MOTION_ACCELERATION_X + 3) r.Acceleration[usage - SENSOR_DATA_MOTION_ACCELERATION_X] = Axis::FromValueCap(cap);
+                if (usage >= SENSOR_DATA_MOTION_ANGULAR_VELOCITY_X && usage < SENSOR_DATA_MOTION_ANGULAR_VELOCITY_X + 3) r.AngularVelocity[usage - SENSOR_DATA_MOTION_ANGULAR_VELOCITY_X] = Axis::FromValueCap(cap);
+            }
+            return r;
+        }
+    };
+
+    /// Axes of a multi-axis controller: translation X, Y, Z, then rotation X, Y, Z.
+    struct MultiAxisLayout
+    {
+        bool Present{};
+        std::array<HidValueField, 6> Axes{};
+        uint32_t ButtonCount{};
+
+        static MultiAxisLayout FromCaps(const std::vector<HIDP_VALUE_CAPS>& value_caps, const std::vector<HIDP_BUTTON_CAPS>& button_caps)
+        {
+            MultiAxisLayout r{true};
+            for (const HIDP_VALUE_CAPS& cap : value_caps)
+            {
+                if (cap.UsagePage != HID_USAGE_PAGE_GENERIC || cap.IsRange) continue;
+                const USAGE usage = cap.NotRange.Usage;
+                if (usage >= HID_USAGE_GENERIC_X && usage <= HID_USAGE_GENERIC_RZ && !r.Axes[usage - HID_USAGE_GENERIC_X].Present)
+                    r.Axes[usage - HID_USAGE_GENERIC_X] = HidValueField::FromValueCap(cap);
+            }
+
+            for (const HIDP_BUTTON_CAPS& cap : button_caps)
+                if (cap.UsagePage == HID_USAGE_PAGE_BUTTON)
+                    r.ButtonCount = std::max<uint32_t>(r.ButtonCount, cap.IsRange ? cap.Range.UsageMax : cap.NotRange.Usage);
+
+            r.ButtonCount = std::min<uint32_t>(r.ButtonCount, 32);
+            return r;
+        }
+    };
+
+    /// Usage to cap table with a collision-free multiplicative hash, built once per device.
+    class UsageIndex final
+    {
+    public:
+        struct Entry
+        {
+            uint32_t Key{};
+            uint16_t CapIndex{HidUsageHandle::kInvalidIndex};
+            uint16_t Bit{};
+        };
+
+        static uint32_t Key(uint16_t page, uint16_t usage) { return static_cast<uint32_t>(page) << 16 | usage; }
+
+    private:
+        std::vector<Entry> table_{};
+        uint32_t multiplier_{};
+        uint32_t shift_{32};
+
+        [[nodiscard]] size_t Slot(uint32_t key) const { return shift_ < 32 ? static_cast<size_t>(key * multiplier_ >> shift_) : 0; }
+
+    public:
+        /// Builds the table. Entries with a duplicated key are dropped except the first one.
+        void Build(const std::vector<Entry>& entries)
+        {
+            if (entries.empty()) return;
+
+            uint32_t bits = 1;
+            while ((size_t{1} << bits) < entries.size() * 2) bits++;
+
+            // Retries with other multipliers, then with a larger table, until no keys collide.
+            for (; bits <= 16; bits++)
+            {
+                for (uint32_t attempt = 0; attempt < 64; attempt++)
+                {
+                    multiplier_ = (0x9E3779B1u + attempt * 0x6A09E667u) | 1u;
+                    shift_ = 32 - bits;
+                    table_.assign(size_t{1} << bits, Entry{});
+
+                    bool collided = false;
+                    for (const Entry& e : entries)
+                    {
+                        Entry& slot = table_[Slot(e.Key)];
+                        if (slot.CapIndex == HidUsageHandle::kInvalidIndex) slot = e;
+                        else if (slot.Key != e.Key) collided = true;
+                        if (collided) break;
+                    }
+
+                    if (!collided) return;
+                }
+            }
+
+            ::OutputDebugStringA("Failed to build usage index");
+            if (::IsDebuggerPresent()) ::DebugBreak();
+            table_.clear();
+        }
+
+        [[nodiscard]] HidUsageHandle Find(uint16_t page, uint16_t usage) const
+        {
+            if (table_.empty()) return {};
+            const uint32_t key = Key(page, usage);
+            const Entry& e = table_[Slot(key)];
+            return e.CapIndex != HidUsageHandle::kInvalidIndex && e.Key == key ? HidUsageHandle{e.CapIndex, e.Bit} : HidUsageHandle{};
+        }
+    };
+
+    /// Simulation page channels of a racing wheel or pedals.
+    struct WheelLayout
+    {
+        bool Present{};
+        HidValueField Steering{};
+        HidValueField Accelerator{};
+        HidValueField Brake{};
+        HidValueField Clutch{};
+        uint32_t ButtonCount{};
+        ULONG MaxUsageListLength{}; // button page
+
+        static WheelLayout FromCaps(const std::vector<HIDP_VALUE_CAPS>& value_caps, const std::vector<HIDP_BUTTON_CAPS>& button_caps, PHIDP_PREPARSED_DATA preparsed)
+        {
+            WheelLayout r{};
+            for (const HIDP_VALUE_CAPS& cap : value_caps)
+            {
+                if (cap.UsagePage != HID_USAGE_PAGE_SIMULATION || cap.IsRange) continue;
+                switch (cap.NotRange.Usage)
+                {
+                case HID_USAGE_SIMULATION_STEERING: r.Steering = HidValueField::FromValueCap(cap);
+                    break;
+                case HID_USAGE_SIMULATION_ACCELLERATOR: r.Accelerator = HidValueField::FromValueCap(cap);
+                    break;
+                case HID_USAGE_SIMULATION_BRAKE: r.Brake = HidValueField::FromValueCap(cap);
+                    break;
+                case HID_USAGE_SIMULATION_CLUTCH: r.Clutch = HidValueField::FromValueCap(cap);
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            r.Present = r.Steering.Present || r.Accelerator.Present || r.Brake.Present || r.Clutch.Present;
+            if (!r.Present) return r;
+
+            for (const HIDP_BUTTON_CAPS& cap : button_caps)
+                if (cap.UsagePage == HID_USAGE_PAGE_BUTTON)
+                    r.ButtonCount = std::max<uint32_t>(r.ButtonCount, cap.IsRange ? cap.Range.UsageMax : cap.NotRange.Usage);
+
+            r.ButtonCount = std::min<uint32_t>(r.ButtonCount, 64);
+            r.MaxUsageListLength = r.ButtonCount ? ::HidP_MaxUsageListLength(HidP_Input, HID_USAGE_PAGE_BUTTON, preparsed) : 0;
+            return r;
+        }
+    };
+
+    /// SDL-compatible joystick GUID: bus, name CRC, vendor, product, version (16-bit little endian each, zero padded).
+    using GamepadGuid = std::array<uint8_t, 16>;
+
+    static GamepadGuid MakeGamepadGuid(uint16_t bus, uint16_t vendor, uint16_t product, uint16_t version)
+    {
+        GamepadGuid g{};
+        const auto put = [&g](size_t offset, uint16_t v) { g[offset] = static_cast<uint8_t>(v), g[offset + 1] = static_cast<uint8_t>(v >> 8); };
+        put(0, bus);
+        put(4, vendor);
+        put(8, product);
+        put(12, version);
+        return g;
+    }
+
+    struct HidDeviceCaps
+    {
+        HANDLE DeviceHandle{};
+        HIDP_CAPS HidPCaps{};
+        std::unique_ptr<std::byte[]> PreparsedDataBlob{};
+        std::vector<HIDP_VALUE_CAPS> ValueCaps{};
+        std::vector<HIDP_BUTTON_CAPS> ButtonCaps{};
+        std::vector<JoystickAxisLayout> JoystickLayout{}; // parallel to ValueCaps
+        UsageIndex ValueIndex{};
+        UsageIndex ButtonIndex{};
+        DigitizerLayout Digitizer{};
+        ConsumerControlLayout ConsumerControl{};
+        ImuLayout Imu{};
+        MultiAxisLayout MultiAxis{};
+        WheelLayout Wheel{};
+        GamepadGuid Guid{};
+        [[nodiscard]] PHIDP_PREPARSED_DATA PreparsedData() const noexcept { return reinterpret_cast<PHIDP_PREPARSED_DATA>(PreparsedDataBlob.get()); }
+
+        static std::unique_ptr<HidDeviceCaps> FromDevice(HANDLE device);
+    };
+
+    /// Reclaims device caps removed from the cache, see RawInputEpochGuard.
+    using CapsEpochDomain = EpochDomain<HidDeviceCaps>;
+
+    /// Invokes consumer callbacks, timing each call against a budget.
+    /// A watchdog thread reports callbacks which are still running past the budget,
+    /// and a consumer which has overrun can be moved to queued delivery on its own thread.
+    class CallbackDispatcher final
+    {
+        /// Delivers queued calls in order on a dedicated thread.
+        /// Pins an epoch while calls are queued, so that device caps referenced by queued events stay alive.
+        class DeliveryQueue final
+        {
+            CapsEpochDomain* epochs_{};
+            std::mutex mutex_{};
+            std::condition_variable condition_{};
+            std::deque<std::function<void()>> queue_{};
+            size_t epoch_slot_{CapsEpochDomain::kInvalidSlot};
+            bool stop_{};
+            std::thread thread_{};
+
+        public:
+            explicit DeliveryQueue(CapsEpochDomain* epochs)
+                : epochs_(epochs)
+                , thread_([this]
+                {
+                    std::unique_lock lock(mutex_);
+                    while (true)
+                    {
+                        condition_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+                        if (queue_.empty()) break; // stop_ and drained
+
+                        std::function<void()> call = std::move(queue_.front());
+                        queue_.pop_front();
+                        lock.unlock();
+                        call();
+                        lock.lock();
+
+                        if (queue_.empty() && epoch_slot_ != CapsEpochDomain::kInvalidSlot)
+                        {
+                            epochs_->Leave(epoch_slot_);
+                            epoch_slot_ = CapsEpochDomain::kInvalidSlot;
+                        }
+                    }
+                })
+            {
+            }
+
+            ~DeliveryQueue()
+            {
+                {
+                    std::lock_guard lock(mutex_);
+                    stop_ = true;
+                }
+                condition_.notify_one();
+                thread_.join();
+            }
+
+            DeliveryQueue(const DeliveryQueue& other) = delete;
+            DeliveryQueue(DeliveryQueue&& other) noexcept = delete;
+            DeliveryQueue& operator=(const DeliveryQueue& other) = delete;
+            DeliveryQueue& operator=(DeliveryQueue&& other) noexcept = delete;
+
+            /// Called on the capture thread.
+            void Push(std::function<void()> call)
+            {
+                {
+                    std::lock_guard lock(mutex_);
+                    if (epoch_slot_ == CapsEpochDomain::kInvalidSlot)
+                        epoch_slot_ = epochs_->Enter();
+                    queue_.push_back(std::move(call));
+                }
+                condition_.notify_one();
+            }
+        };
+
+        struct CallbackState
+        {
+            std::atomic<uint64_t> CallCount{};
+            std::atomic<TIMESTAMP> TotalTime{};
+            std::atomic<TIMESTAMP> MaxTime{};
+            std::atomic<uint64_t> OverrunCount{};
+            std::atomic<bool> Queued{};
+            std::unique_ptr<DeliveryQueue> Queue{};
+        };
+
+        CapsEpochDomain* epochs_{};
+        TIMESTAMP budget_{};
+        bool queue_overrunning_callbacks_{};
+        CallbackOverrunCallback on_overrun_{};
+        std::array<CallbackState, kRawInputCallbackKindCount> states_{};
+
+        // In-flight call on the capture thread: (kind + 1) << 56 | start time. 0: none.
+        std::atomic<uint64_t> in_flight_{};
+        std::atomic<uint64_t> in_flight_reported_{};
+
+        std::mutex watchdog_mutex_{};
+        std::condition_variable watchdog_condition_{};
+        bool watchdog_stop_{};
+        std::thread watchdog_{};
+
+    public:
+        CallbackDispatcher(CapsEpochDomain* epochs, TIMESTAMP budget, bool queue_overrunning_callbacks, CallbackOverrunCallback on_overrun)
+            : epochs_(epochs)
+            , budget_(budget)
+            , queue_overrunning_callbacks_(queue_overrunning_callbacks)
+            , on_overrun_(std::move(on_overrun))
+        {
+            if (budget_ > 0)
+            {
+                watchdog_ = std::thread([this] { RunWatchdog(); });
+            }
+        }
+
+        ~CallbackDispatcher()
+        {
+            if (watchdog_.joinable())
+            {
+                {
+                    std::lock_guard lock(watchdog_mutex_);
+                    watchdog_stop_ = true;
+                }
+                watchdog_condition_.notify_one();
+                watchdog_.join();
+            }
+
+            for (auto&& state : states_)
+                state.Queue.reset(); // drains and joins
+        }
+
+        CallbackDispatcher(const CallbackDispatcher& other) = delete;
+        CallbackDispatcher(CallbackDispatcher&& other) noexcept = delete;
+        CallbackDispatcher& operator=(const CallbackDispatcher& other) = delete;
+        CallbackDispatcher& operator=(CallbackDispatcher&& other) noexcept = delete;
+
+        /// Invokes a callback on the capture thread.
+        /// @param call calls the callback in place.
+        /// @param make_queued_call makes a self-contained call used for queued delivery (copies the event).
+        template <class TCall, class TMakeQueuedCall>
+        void InvokeCall(RawInputCallbackKind kind, TCall&& call, TMakeQueuedCall&& make_queued_call)
+        {
+            if (budget_ <= 0)
+            {
+                call();
+                return;
+            }
+
+            CallbackState& state = states_[static_cast<size_t>(kind)];
+            if (state.Queued.load(std::memory_order_relaxed))
+            {
+                state.Queue->Push(make_queued_call());
+                return;
+            }
+
+            const TIMESTAMP start = Clock();
+            in_flight_.store((static_cast<uint64_t>(kind) + 1) << 56 | static_cast<uint64_t>(start), std::memory_order_relaxed);
+            call();
+            in_flight_.store(0, std::memory_order_relaxed);
+            const TIMESTAMP duration = Clock() - start;
+
+            // Written only by capture thread.
+            state.CallCount.store(state.CallCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            state.TotalTime.store(state.TotalTime.load(std::memory_order_relaxed) + duration, std::memory_order_relaxed);
+            if (duration > state.MaxTime.load(std::memory_order_relaxed)) state.MaxTime.store(duration, std::memory_order_relaxed);
+
+            if (duration > budget_)
+            {
+                state.OverrunCount.fetch_add(1, std::memory_order_relaxed);
+
+                // Switches after the call has returned, so the consumer is never called concurrently.
+                if (queue_overrunning_callbacks_)
+                {
+                    state.Queue = std::make_unique<DeliveryQueue>(epochs_);
+                    state.Queued.store(true, std::memory_order_relaxed);
+                }
+
+                if (on_overrun_)
+                {
+                    on_overrun_(CallbackOverrun{kind, start, duration, true, queue_overrunning_callbacks_});
+                }
+            }
+        }
+
+        /// Invokes an event callback.
+        template <class TEvent>
+        void Invoke(RawInputCallbackKind kind, const std::function<void(const TEvent&)>& callback, const TEvent& e)
+        {
+            InvokeCall(kind, [&] { callback(e); }, [&] { return [&callback, e] { callback(e); }; });
+        }
+
+        RawInputCallbackStatistics Statistics(RawInputCallbackKind kind) const
+        {
+            const CallbackState& state = states_[static_cast<size_t>(kind)];
+            RawInputCallbackStatistics r{};
+            r.CallCount = state.CallCount.load(std::memory_order_relaxed);
+            r.TotalTime = state.TotalTime.load(std::memory_order_relaxed);
+            r.MaxTime = state.MaxTime.load(std::memory_order_relaxed);
+            r.OverrunCount = state.OverrunCount.load(std::memory_order_relaxed);
+            r.Queued = state.Queued.load(std::memory_order_relaxed);
+            return r;
+        }
+
+    private:
+        void RunWatchdog()
+        {
+            const auto period = std::chrono::microseconds(std::max<TIMESTAMP>(budget_, 1000));
+
+            std::unique_lock lock(watchdog_mutex_);
+            while (!watchdog_condition_.wait_for(lock, period, [this] { return watchdog_stop_; }))
+            {
+                const uint64_t in_flight = in_flight_.load(std::memory_order_relaxed);
+                if (in_flight == 0 || in_flight == in_flight_reported_.load(std::memory_order_relaxed))
+                    continue;
+
+                const auto kind = static_cast<RawInputCallbackKind>((in_flight >> 56) - 1);
+                const auto start = static_cast<TIMESTAMP>(in_flight & ((1ull << 56) - 1));
+                const TIMESTAMP elapsed = Clock() - start;
+                if (elapsed <= budget_)
+                    continue;
+
+                // Reports once per call.
+                in_flight_reported_.store(in_flight, std::memory_order_relaxed);
+                if (on_overrun_)
+                {
+                    lock.unlock();
+                    on_overrun_(CallbackOverrun{kind, start, elapsed, false, false});
+                    lock.lock();
+                }
+            }
+        }
+    };
+
+    /// Decodes contacts in a digitizer report.
+    static TouchReport ParseTouchReport(const HidDeviceCaps& caps, PCHAR report, ULONG report_size)
+    {
+        TouchReport r{};
+        const DigitizerLayout& layout = caps.Digitizer;
+        const PHIDP_PREPARSED_DATA preparsed = caps.PreparsedData();
+
+        if (auto v = layout.ContactCount.Read(preparsed, report, report_size)) r.ContactCount = static_cast<uint32_t>(*v);
+        if (auto v = layout.ScanTime.Read(preparsed, report, report_size)) r.ScanTime = static_cast<uint32_t>(*v);
+
+        for (const DigitizerContactLayout& c : layout.Contacts)
+        {
+            const auto x = c.X.Read(preparsed, report, report_size);
+            const auto y = c.Y.Read(preparsed, report, report_size);
+            if (!x || !y) continue; // in another report
+
+            const auto id = c.ContactId.Read(preparsed, report, report_size);
+            const auto tip = ReadDigitizerButton(preparsed, c.LinkCollection, DIGITIZER_USAGE_TIP_SWITCH, report, report_size);
+
+            // Width and height are in the units of X and Y.
+            TouchContact contact{};
+            contact.ContactId = static_cast<uint32_t>(id.value_or(static_cast<int32_t>(&c - layout.Contacts.data())));
+            contact.X = c.X.Normalize(*x);
+            contact.Y = c.Y.Normalize(*y);
+            if (auto w = c.Width.Read(preparsed, report, report_size); w && c.X.Max > c.X.Min) contact.Width = static_cast<float>(*w) / static_cast<float>(static_cast<int64_t>(c.X.Max) - c.X.Min);
+            if (auto h = c.Height.Read(preparsed, report, report_size); h && c.Y.Max > c.Y.Min) contact.Height = static_cast<float>(*h) / static_cast<float>(static_cast<int64_t>(c.Y.Max) - c.Y.Min);
+            contact.Pressure = c.Pressure.ReadNormalized(preparsed, report, report_size).value_or(0.0f);
+            r.Contacts.push_back({contact, tip.value_or(true)});
+        }
+
+        if (!layout.ContactCount.Present) r.ContactCount = static_cast<uint32_t>(r.Contacts.size());
+        return r;
+    }
+
+    /// Decodes a pen sample from a digitizer report.
+    /// @returns nullopt: the report does not contain the stylus.
+    static std::optional<PenEvent> ParsePenReport(const HidDeviceCaps& caps, HANDLE device, TIMESTAMP timestamp, PCHAR report, ULONG report_size)
+    {
+        const DigitizerStylusLayout& stylus = *caps.Digitizer.Stylus;
+        const PHIDP_PREPARSED_DATA preparsed = caps.PreparsedData();
+
+        const auto x = stylus.X.ReadNormalized(preparsed, report, report_size);
+        const auto y = stylus.Y.ReadNormalized(preparsed, report, report_size);
+        if (!x || !y) return std::nullopt;
+
+        PenEvent e{device, timestamp, *x, *y};
+        e.Pressure = stylus.Pressure.ReadNormalized(preparsed, report, report_size).value_or(0.0f);
+        if (auto v = stylus.TiltX.ReadNormalized(preparsed, report, report_size)) e.TiltX = *v * 180.0f - 90.0f;
+        if (auto v = stylus.TiltY.ReadNormalized(preparsed, report, report_size)) e.TiltY = *v * 180.0f - 90.0f;
+
+        USAGE pressed[32]{};
+        ULONG len = static_cast<ULONG>(std::size(pressed));
+        if (::HidP_GetUsages(HidP_Input, HID_USAGE_PAGE_DIGITIZER, stylus.LinkCollection, pressed, &len, preparsed, report, report_size) == HIDP_STATUS_SUCCESS)
+        {
+            for (ULONG i = 0; i < len; i++)
+            {
+                switch (pressed[i])
+                {
+                case DIGITIZER_USAGE_IN_RANGE: e.InRange = true;
+                    break;
+                case DIGITIZER_USAGE_TIP_SWITCH: e.Tip = true;
+                    break;
+                case DIGITIZER_USAGE_BARREL_SWITCH: e.Barrel = true;
+                    break;
+                case DIGITIZER_USAGE_SECONDARY_BARREL_SWITCH: e.SecondaryBarrel = true;
+                    break;
+                case DIGITIZER_USAGE_ERASER: e.Eraser = true;
+                    break;
+                case DIGITIZER_USAGE_INVERT: e.Invert = true;
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        // Touching implies in range, for devices without In Range.
+        e.InRange |= e.Tip || e.Eraser;
+        return e;
+    }
+
+    /// Decodes a consumer control report.
+    static ConsumerControlEvent ParseConsumerControlReport(const HidDeviceCaps& caps, HANDLE device, TIMESTAMP timestamp, PCHAR report, ULONG report_size)
+    {
+        ConsumerControlEvent e{device, timestamp};
+        const PHIDP_PREPARSED_DATA preparsed = caps.PreparsedData();
+
+        // Buttons and selector arrays.
+        // HidP_GetUsages fails if the buffer is shorter than the device can report, so sizes it by the caps and truncates afterwards.
+        if (ULONG len = caps.ConsumerControl.MaxUsageListLength; len != 0)
+        {
+            USAGE stack_buf[64]{};
+            std::unique_ptr<USAGE[]> heap_buf{};
+            USAGE* pressed = stack_buf;
+            if (len > std::size(stack_buf))
+            {
+                heap_buf = std::make_unique<USAGE[]>(len);
+                pressed = heap_buf.get();
+            }
+
+            if (::HidP_GetUsages(HidP_Input, HID_USAGE_PAGE_CONSUMER, 0, pressed, &len, preparsed, report, report_size) == HIDP_STATUS_SUCCESS)
+            {
+                for (ULONG i = 0; i < len && e.Pressed.size() < e.Pressed.capacity(); i++)
+                    e.Pressed.push_back(pressed[i]);
+            }
+        }
+
+        // Encoders with the same usage (e.g. several knobs for volume) are summed.
+        std::array<int32_t, ConsumerControlEvent::kMaxCountOfEncoders> delta{};
+        std::array<uint16_t, ConsumerControlEvent::kMaxCountOfEncoders> usage{};
+        size_t count = 0;
+        for (const HidValueField& encoder : caps.ConsumerControl.Encoders)
+        {
+            const auto v = encoder.Read(preparsed, report, report_size);
+            if (!v) continue;
+
+            size_t i = 0;
+            while (i < count && usage[i] != encoder.Usage) i++;
+            if (i == count)
+            {
+                if (count == usage.size()) continue;
+                usage[count++] = encoder.Usage;
+            }
+            delta[i] += *v;
+        }
+
+        for (size_t i = 0; i < count; i++)
+            e.Encoders.push_back({usage[i], delta[i]});
+
+        return e;
+    }
+
+    /// Decodes an IMU sample.
+    /// @returns nullopt: the report does not contain the sensors.
+    static std::optional<ImuEvent> ParseImuReport(const HidDeviceCaps& caps, HANDLE device, TIMESTAMP timestamp, PCHAR report, ULONG report_size)
+    {
+        ImuEvent e{device, timestamp};
+        const PHIDP_PREPARSED_DATA preparsed = caps.PreparsedData();
+
+        const auto read = [&](const std::array<ImuLayout::Axis, 3>& axes, std::array<float, 3>& out)
+        {
+            for (size_t i = 0; i < 3; i++)
+            {
+                auto v = axes[i].Read(preparsed, report, report_size);
+                if (!v) return false;
+                out[i] = *v;
+            }
+            return true;
+        };
+
+        e.HasAcceleration = caps.Imu.HasAcceleration() && read(caps.Imu.Acceleration, e.Acceleration);
+        e.HasAngularVelocity = caps.Imu.HasAngularVelocity() && read(caps.Imu.AngularVelocity, e.AngularVelocity);
+        if (!e.HasAcceleration && !e.HasAngularVelocity) return std::nullopt;
+        return e;
+    }
+
+    /// Decodes wheel channels in a report into the (possibly merged) wheel state.
+    /// @returns true if the report has any wheel channel or button.
+    static bool DecodeWheelReport(const HidDeviceCaps& caps, PCHAR report, ULONG report_size, uint32_t button_offset, WheelEvent& state)
+    {
+        const WheelLayout& layout = caps.Wheel;
+        const PHIDP_PREPARSED_DATA preparsed = caps.PreparsedData();
+        bool updated = false;
+
+        if (auto v = layout.Steering.Read(preparsed, report, report_size))
+        {
+            const double center = (static_cast<double>(layout.Steering.Min) + layout.Steering.Max) / 2.0;
+            const double half = (static_cast<double>(layout.Steering.Max) - layout.Steering.Min) / 2.0;
+            state.HasSteering = true;
+            state.SteeringValue = *v;
+            state.SteeringMin = layout.Steering.Min;
+            state.SteeringMax = layout.Steering.Max;
+            state.Steering = half > 0 ? std::clamp((*v - center) / half, -1.0, 1.0) : 0.0;
+            updated = true;
+        }
+
+        if (auto v = layout.Accelerator.ReadNormalized(preparsed, report, report_size)) state.HasAccelerator = true, state.Accelerator = *v, updated = true;
+        if (auto v = layout.Brake.ReadNormalized(preparsed, report, report_size)) state.HasBrake = true, state.Brake = *v, updated = true;
+        if (auto v = layout.Clutch.ReadNormalized(preparsed, report, report_size)) state.HasClutch = true, state.Clutch = *v, updated = true;
+
+        // HidP_GetUsages fails if the buffer is shorter than the device can report, so sizes it by the caps.
+        if (ULONG len = layout.MaxUsageListLength; len != 0)
+        {
+            USAGE stack_buf[64]{};
+            std::unique_ptr<USAGE[]> heap_buf{};
+            USAGE* pressed = stack_buf;
+            if (len > std::size(stack_buf))
+            {
+                heap_buf = std::make_unique<USAGE[]>(len);
+                pressed = heap_buf.get();
+            }
+
+            if (::HidP_GetUsages(HidP_Input, HID_USAGE_PAGE_BUTTON, 0, pressed, &len, preparsed, report, report_size) == HIDP_STATUS_SUCCESS)
+            {
+                for (uint32_t i = 0; i < layout.ButtonCount && button_offset + i < state.Buttons.size(); i++)
+                    state.Buttons.reset(button_offset + i);
+                for (ULONG i = 0; i < len; i++)
+                    if (pressed[i] >= 1 && pressed[i] <= layout.ButtonCount && button_offset + pressed[i] - 1 < state.Buttons.size())
+                        state.Buttons.set(button_offset + pressed[i] - 1);
+                updated = true;
+            }
+        }
+
+        return updated;
+    }
+
+    /// Carries sub-notch wheel deltas and accumulates mouse input of a mouse.
+    struct MouseStateTracker
+    {
+        int32_t WheelRemainder{};
+        int32_t HorizontalWheelRemainder{};
+        MouseEvent::ButtonIndex HeldButtons{};
+        RawInputMouseAccumulation Accumulation{};       // for DrainRawInputMouseAccumulation
+        RawInputMouseAccumulation CursorAccumulation{}; // for UpdateRawInputCursors
+
+        /// Fills wheel notches of the event.
+        void Feed(MouseEvent& e)
+        {
+            e.WheelNotches = TakeNotches(WheelRemainder, e.WheelDelta());
+            e.HorizontalWheelNotches = TakeNotches(HorizontalWheelRemainder, e.HorizontalWheelDelta());
+            HeldButtons = static_cast<MouseEvent::ButtonIndex>((static_cast<uint32_t>(HeldButtons) | static_cast<uint32_t>(e.PressedButtons())) & ~static_cast<uint32_t>(e.ReleasedButtons()));
+
+            for (RawInputMouseAccumulation* a : {&Accumulation, &CursorAccumulation})
+            {
+                a->EventCount++;
+                if (!e.LastXYIsAbsolute())
+                {
+                    a->X += e.LastX();
+                    a->Y += e.LastY();
+                }
+                else
+                {
+                    a->HasAbsolutePosition = true;
+                    a->AbsoluteX = e.LastX();
+                    a->AbsoluteY = e.LastY();
+                }
+                a->WheelDelta += e.WheelDelta();
+                a->HorizontalWheelDelta += e.HorizontalWheelDelta();
+                a->WheelNotches += e.WheelNotches;
+                a->HorizontalWheelNotches += e.HorizontalWheelNotches;
+                a->PressedButtons = static_cast<MouseEvent::ButtonIndex>(static_cast<uint32_t>(a->PressedButtons) | static_cast<uint32_t>(e.PressedButtons()));
+                a->ReleasedButtons = static_cast<MouseEvent::ButtonIndex>(static_cast<uint32_t>(a->ReleasedButtons) | static_cast<uint32_t>(e.ReleasedButtons()));
+                a->HeldButtons = HeldButtons;
+            }
+        }
+
+        /// Takes the accumulation, keeping the held buttons.
+        static RawInputMouseAccumulation Take(RawInputMouseAccumulation& a)
+        {
+            RawInputMouseAccumulation r = a;
+            a = {};
+            a.HeldButtons = r.HeldButtons;
+            return r;
+        }
+
+        /// Adds the delta to the remainder and takes whole notches out. Reversing the direction drops the remainder.
+        static int32_t TakeNotches(int32_t& remainder, int32_t delta)
+        {
+            if (delta == 0) return 0;
+            if ((remainder ^ delta) < 0) remainder = 0;
+            remainder += delta;
+            const int32_t notches = remainder / WHEEL_DELTA;
+            remainder -= notches * WHEEL_DELTA;
+            return notches;
+        }
+    };
+
+    /// Cursors of mice, one per device. Kept in SoA arrays and moved in one pass per update.
+    class MultiCursorManager final
+    {
+        RawInputCursorOptions default_options_;
+
+        // Cursors
+        std::vector<HANDLE> devices_{};
+        std::vector<float> xs_{};
+        std::vector<float> ys_{};
+        std::vector<float> lefts_{};
+        std::vector<float> tops_{};
+        std::vector<float> rights_{};
+        std::vector<float> bottoms_{};
+        std::vector<float> sensitivities_{};
+        std::vector<float> accelerations_{};
+        std::vector<float> max_gains_{};
+        std::vector<uint32_t> buttons_{};
+        std::vector<uint32_t> pressed_{};
+        std::vector<uint32_t> released_{};
+        std::vector<TIMESTAMP> update_times_{};
+        std::vector<uint8_t> seen_{}; // has sent input
+
+        // Input of the update
+        std::vector<float> dxs_{};
+        std::vector<float> dys_{};
+        std::vector<uint8_t> absolute_{};
+        std::vector<float> absolute_xs_{};
+        std::vector<float> absolute_ys_{};
+        std::vector<uint8_t> alive_{};
+
+        template <class TFunc>
+        void ForEachArray(TFunc&& f)
+        {
+            f(devices_), f(xs_), f(ys_), f(lefts_), f(tops_), f(rights_), f(bottoms_), f(sensitivities_), f(accelerations_), f(max_gains_);
+            f(buttons_), f(pressed_), f(released_), f(update_times_), f(seen_);
+            f(dxs_), f(dys_), f(absolute_), f(absolute_xs_), f(absolute_ys_), f(alive_);
+        }
+
+        size_t IndexOf(HANDLE device, TIMESTAMP now)
+        {
+            for (size_t i = 0; i < devices_.size(); i++)
+                if (devices_[i] == device)
+                    return i;
+
+            ForEachArray([](auto& v) { v.emplace_back(); });
+            const size_t i = devices_.size() - 1;
+            devices_[i] = device;
+            update_times_[i] = now;
+            SetOptions(i, default_options_);
+            xs_[i] = (lefts_[i] + rights_[i]) / 2.0f;
+            ys_[i] = (tops_[i] + bottoms_[i]) / 2.0f;
+            return i;
+        }
+
+        void SetOptions(size_t i, const RawInputCursorOptions& o)
+        {
+            lefts_[i] = o.Left;
+            tops_[i] = o.Top;
+            rights_[i] = std::max(o.Left, o.Right);
+            bottoms_[i] = std::max(o.Top, o.Bottom);
+            sensitivities_[i] = o.Sensitivity;
+            accelerations_[i] = o.Acceleration;
+            max_gains_[i] = o.MaxGain > 0.0f ? o.MaxGain : std::numeric_limits<float>::max();
+            xs_[i] = std::clamp(xs_[i], lefts_[i], rights_[i]);
+            ys_[i] = std::clamp(ys_[i], tops_[i], bottoms_[i]);
+        }
+
+    public:
+        explicit MultiCursorManager(RawInputCursorOptions default_options) : default_options_(default_options) { }
+
+        void Configure(HANDLE device, const RawInputCursorOptions& options) { SetOptions(IndexOf(device, Clock()), options); }
+
+        /// Moves cursors.
+        /// @param for_each_accumulation called with a visitor taking (device, accumulation) of every present mouse
+        template <class TForEachAccumulation>
+        void Update(TIMESTAMP now, TForEachAccumulation&& for_each_accumulation)
+        {
+            std::fill(dxs_.begin(), dxs_.end(), 0.0f);
+            std::fill(dys_.begin(), dys_.end(), 0.0f);
+            std::fill(absolute_.begin(), absolute_.end(), uint8_t{});
+            std::fill(alive_.begin(), alive_.end(), uint8_t{});
+
+            // Gathers input.
+            for_each_accumulation([&](HANDLE device, const RawInputMouseAccumulation& a)
+            {
+                const size_t i = IndexOf(device, now);
+                alive_[i] = seen_[i] = 1;
+                dxs_[i] = static_cast<float>(a.X);
+                dys_[i] = static_cast<float>(a.Y);
+                absolute_[i] = a.HasAbsolutePosition;
+                absolute_xs_[i] = static_cast<float>(a.AbsoluteX) / 65535.0f;
+                absolute_ys_[i] = static_cast<float>(a.AbsoluteY) / 65535.0f;
+                buttons_[i] = static_cast<uint32_t>(a.HeldButtons);
+                pressed_[i] = static_cast<uint32_t>(a.PressedButtons);
+                released_[i] = static_cast<uint32_t>(a.ReleasedButtons);
+            });
+
+            // Drops cursors of removed mice, keeping configured ones which have not sent input yet.
+            for (size_t i = devices_.size(); i-- > 0;)
+            {
+                if (alive_[i] || !seen_[i]) continue;
+                ForEachArray([i](auto& v) { v[i] = v.back(), v.pop_back(); });
+            }
+
+            // Moves all cursors.
+            const size_t n = devices_.size();
+            for (size_t i = 0; i < n; i++)
+            {
+                const float dt_ms = std::max(static_cast<float>(now - update_times_[i]) / 1000.0f, 1.0f);
+                const float speed = std::sqrt(dxs_[i] * dxs_[i] + dys_[i] * dys_[i]) / dt_ms;
+                const float gain = std::min(sensitivities_[i] * (1.0f + accelerations_[i] * speed), max_gains_[i]);
+                const float x = absolute_[i] ? lefts_[i] + (rights_[i] - lefts_[i]) * absolute_xs_[i] : xs_[i];
+                const float y = absolute_[i] ? tops_[i] + (bottoms_[i] - tops_[i]) * absolute_ys_[i] : ys_[i];
+                xs_[i] = std::clamp(x + dxs_[i] * gain, lefts_[i], rights_[i]);
+                ys_[i] = std::clamp(y + dys_[i] * gain, tops_[i], bottoms_[i]);
+                update_times_[i] = now;
+            }
+        }
+
+        [[nodiscard]] std::vector<RawInputCursor> Cursors() const
+        {
+            std::vector<RawInputCursor> r(devices_.size());
+            for (size_t i = 0; i < r.size(); i++)
+            {
+                r[i] = RawInputCursor{
+                    devices_[i], xs_[i], ys_[i],
+                    static_cast<MouseEvent::ButtonIndex>(buttons_[i]),
+                    static_cast<MouseEvent::ButtonIndex>(pressed_[i]),
+                    static_cast<MouseEvent::ButtonIndex>(released_[i]),
+                };
+            }
+            return r;
+        }
+    };
+
+    /// Source of a standard gamepad control in a mapping.
+    struct GamepadBinding
+    {
+        enum struct SourceKind : uint8_t
+        {
+            None,
+            Button,
+            Axis,
+            Hat,
+        };
+
+        SourceKind Kind{};
+        uint8_t Index{};
+        uint8_t HatMask{};   // 1: up, 2: right, 4: down, 8: left
+        int8_t InputHalf{};  // +1/-1: uses the half of the axis
+        int8_t OutputHalf{}; // +1/-1: drives the half of the output axis
+        bool Invert{};
+
+        /// Parses SDL binding (e.g. "b0", "a2~", "+a3", "h0.4").
+        static std::optional<GamepadBinding> Parse(std::string_view text)
+        {
+            GamepadBinding r{};
+            if (!text.empty() && (text.front() == '+' || text.front() == '-')) r.InputHalf = text.front() == '+' ? 1 : -1, text.remove_prefix(1);
+            if (!text.empty() && text.back() == '~') r.Invert = true, text.remove_suffix(1);
+            if (text.size() < 2) return std::nullopt;
+
+            const auto number = [](std::string_view digits) -> std::optional<uint32_t>
+            {
+                if (digits.empty() || digits.size() > 3) return std::nullopt;
+                uint32_t n = 0;
+                for (char c : digits)
+                {
+                    if (c < '0' || c > '9') return std::nullopt;
+                    n = n * 10 + static_cast<uint32_t>(c - '0');
+                }
+                return n <= 255 ? std::optional<uint32_t>(n) : std::nullopt;
+            };
+
+            const char kind = text.front();
+            text.remove_prefix(1);
+            if (kind == 'b' || kind == 'a')
+            {
+                const auto n = number(text);
+                if (!n) return std::nullopt;
+                r.Kind = kind == 'b' ? SourceKind::Button : SourceKind::Axis;
+                r.Index = static_cast<uint8_t>(*n);
+                return r;
+            }
+
+            if (kind == 'h')
+            {
+                const size_t dot = text.find('.');
+                if (dot == std::string_view::npos) return std::nullopt;
+                const auto n = number(text.substr(0, dot));
+                const auto mask = number(text.substr(dot + 1));
+                if (!n || !mask) return std::nullopt;
+                r.Kind = SourceKind::Hat;
+                r.Index = static_cast<uint8_t>(*n);
+                r.HatMask = static_cast<uint8_t>(*mask);
+                return r;
+            }
+
+            return std::nullopt;
+        }
+    };
+
+    /// Gamepad mapping of a device model.
+    struct GamepadMapping
+    {
+        std::array<GamepadBinding, kStandardGamepadButtonCount> Buttons{};
+
+        /// [0]: full axis or negative half, [1]: positive half.
+        std::array<std::array<GamepadBinding, 2>, kStandardGamepadAxisCount> Axes{};
+
+        /// Sets a binding to an SDL target name (e.g. "a", "leftx", "+lefty").
+        /// @returns false: unknown target
+        bool Bind(std::string_view target, GamepadBinding binding)
+        {
+            static constexpr std::string_view BUTTON_NAMES[kStandardGamepadButtonCount] = {
+                "a", "b", "x", "y", "back", "guide", "start", "leftstick", "rightstick", "leftshoulder", "rightshoulder",
+                "dpup", "dpdown", "dpleft", "dpright", "misc1", "paddle1", "paddle2", "paddle3", "paddle4", "touchpad",
+            };
+            static constexpr std::string_view AXIS_NAMES[kStandardGamepadAxisCount] = {
+                "leftx", "lefty", "rightx", "righty", "lefttrigger", "righttrigger",
+            };
+
+            if (!target.empty() && (target.front() == '+' || target.front() == '-')) binding.OutputHalf = target.front() == '+' ? 1 : -1, target.remove_prefix(1);
+
+            for (size_t i = 0; i < std::size(BUTTON_NAMES); i++)
+                if (target == BUTTON_NAMES[i])
+                    return Buttons[i] = binding, true;
+
+            for (size_t i = 0; i < std::size(AXIS_NAMES); i++)
+                if (target == AXIS_NAMES[i])
+                    return Axes[i][binding.OutputHalf > 0 ? 1 : 0] = binding, true;
+
+            return false;
+        }
+
+        /// Sets a binding from a "target:source" field. Other fields (e.g. the name) are ignored.
+        void BindField(std::string_view field)
+        {
+            const size_t colon = field.find(':');
+            if (colon == std::string_view::npos) return;
+            if (auto binding = GamepadBinding::Parse(field.substr(colon + 1)))
+                Bind(field.substr(0, colon), *binding);
+        }
+
+        /// Parses comma-separated "target:source" fields.
+        static GamepadMapping FromFields(std::string_view fields)
+        {
+            GamepadMapping r{};
+            while (!fields.empty())
+            {
+                const size_t comma = fields.find(',');
+                r.BindField(fields.substr(0, comma));
+                fields.remove_prefix(comma == std::string_view::npos ? fields.size() : comma + 1);
+            }
+            return r;
+        }
+    };
+
+    /// Built-in mappings for common gamepads with their Windows HID layouts.
+    static constexpr std::string_view kBuiltinGamepadMappings =
+        "030000005e0400008e02000000000000,Xbox 360 Controller,a:b0,b:b1,x:b2,y:b3,back:b6,start:b7,leftstick:b8,rightstick:b9,leftshoulder:b4,rightshoulder:b5,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a3,righty:a4,lefttrigger:+a2,righttrigger:-a2,platform:Windows,\n"
+        "030000005e0400001907000000000000,Xbox 360 Wireless Controller,a:b0,b:b1,x:b2,y:b3,back:b6,start:b7,leftstick:b8,rightstick:b9,leftshoulder:b4,rightshoulder:b5,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a3,righty:a4,lefttrigger:+a2,righttrigger:-a2,platform:Windows,\n"
+        "030000005e040000d102000000000000,Xbox One Controller,a:b0,b:b1,x:b2,y:b3,back:b6,start:b7,leftstick:b8,rightstick:b9,leftshoulder:b4,rightshoulder:b5,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a3,righty:a4,lefttrigger:+a2,righttrigger:-a2,platform:Windows,\n"
+        "030000005e040000dd02000000000000,Xbox One Controller,a:b0,b:b1,x:b2,y:b3,back:b6,start:b7,leftstick:b8,rightstick:b9,leftshoulder:b4,rightshoulder:b5,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a3,righty:a4,lefttrigger:+a2,righttrigger:-a2,platform:Windows,\n"
+        "030000005e040000ea02000000000000,Xbox One S Controller,a:b0,b:b1,x:b2,y:b3,back:b6,start:b7,leftstick:b8,rightstick:b9,leftshoulder:b4,rightshoulder:b5,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a3,righty:a4,lefttrigger:+a2,righttrigger:-a2,platform:Windows,\n"
+        "030000005e040000120b000000000000,Xbox Series Controller,a:b0,b:b1,x:b2,y:b3,back:b6,start:b7,leftstick:b8,rightstick:b9,leftshoulder:b4,rightshoulder:b5,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a3,righty:a4,lefttrigger:+a2,righttrigger:-a2,platform:Windows,\n"
+        "030000004c050000c405000000000000,PS4 Controller,a:b1,b:b2,x:b0,y:b3,back:b8,guide:b12,start:b9,leftstick:b10,rightstick:b11,leftshoulder:b4,rightshoulder:b5,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a2,righty:a5,lefttrigger:a3,righttrigger:a4,touchpad:b13,platform:Windows,\n"
+        "050000004c050000c405000000000000,PS4 Controller,a:b1,b:b2,x:b0,y:b3,back:b8,guide:b12,start:b9,leftstick:b10,rightstick:b11,leftshoulder:b4,rightshoulder:b5,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a2,righty:a5,lefttrigger:a3,righttrigger:a4,touchpad:b13,platform:Windows,\n"
+        "030000004c050000cc09000000000000,PS4 Controller,a:b1,b:b2,x:b0,y:b3,back:b8,guide:b12,start:b9,leftstick:b10,rightstick:b11,leftshoulder:b4,rightshoulder:b5,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a2,righty:a5,lefttrigger:a3,righttrigger:a4,touchpad:b13,platform:Windows,\n"
+        "050000004c050000cc09000000000000,PS4 Controller,a:b1,b:b2,x:b0,y:b3,back:b8,guide:b12,start:b9,leftstick:b10,rightstick:b11,leftshoulder:b4,rightshoulder:b5,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a2,righty:a5,lefttrigger:a3,righttrigger:a4,touchpad:b13,platform:Windows,\n"
+        "030000004c050000e60c000000000000,PS5 Controller,a:b1,b:b2,x:b0,y:b3,back:b8,guide:b12,start:b9,leftstick:b10,rightstick:b11,leftshoulder:b4,rightshoulder:b5,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a2,righty:a5,lefttrigger:a3,righttrigger:a4,touchpad:b13,misc1:b14,platform:Windows,\n"
+        "030000006d04000016c2000000000000,Logitech F310 (DirectInput),a:b1,b:b2,x:b0,y:b3,back:b8,start:b9,leftstick:b10,rightstick:b11,leftshoulder:b4,rightshoulder:b5,lefttrigger:b6,righttrigger:b7,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a2,righty:a3,platform:Windows,\n"
+        "030000006d04000019c2000000000000,Logitech F710 (DirectInput),a:b1,b:b2,x:b0,y:b3,back:b8,start:b9,leftstick:b10,rightstick:b11,leftshoulder:b4,rightshoulder:b5,lefttrigger:b6,righttrigger:b7,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a2,righty:a3,platform:Windows,\n";
+
+    /// Fallback for unknown devices with the Gamepad top-level usage: the usual DirectInput pad (X/Y, Z/Rz sticks, hat d-pad).
+    static constexpr std::string_view kGenericGamepadMapping =
+        "a:b0,b:b1,x:b2,y:b3,leftshoulder:b4,rightshoulder:b5,back:b6,start:b7,leftstick:b8,rightstick:b9,dpup:h0.1,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,leftx:a0,lefty:a1,rightx:a2,righty:a3";
+
+    /// Gamepad mappings by GUID.
+    class GamepadMappingDatabase final
+    {
+        struct GuidHash
+        {
+            size_t operator()(const GamepadGuid& g) const noexcept
+            {
+                uint64_t h = 14695981039346656037ull; // FNV-1a
+                for (uint8_t b : g) h = (h ^ b) * 1099511628211ull;
+                return static_cast<size_t>(h);
+            }
+        };
+
+        std::unordered_map<GamepadGuid, GamepadMapping, GuidHash> mappings_{};
+
+        static std::optional<GamepadGuid> ParseGuid(std::string_view hex)
+        {
+            if (hex.size() != 32) return std::nullopt;
+            const auto nibble = [](char c) -> int
+            {
+                if (c >= '0' && c <= '9') return c - '0';
+                if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+                if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+                return -1;
+            };
+
+            GamepadGuid g{};
+            for (size_t i = 0; i < g.size(); i++)
+            {
+                const int hi = nibble(hex[i * 2]), lo = nibble(hex[i * 2 + 1]);
+                if (hi < 0 || lo < 0) return std::nullopt;
+                g[i] = static_cast<uint8_t>(hi << 4 | lo);
+            }
+            return g;
+        }
+
+    public:
+        GamepadMappingDatabase() { Load(kBuiltinGamepadMappings); }
+
+        /// Loads mappings in gamecontrollerdb.txt format: "GUID,name,target:source,...,platform:Windows,"
+        /// @returns count of loaded mappings
+        size_t Load(std::string_view text)
+        {
+            mappings_.reserve(mappings_.size() + static_cast<size_t>(std::count(text.begin(), text.end(), '\n')) + 1);
+
+            size_t loaded = 0;
+            while (!text.empty())
+            {
+                const size_t eol = text.find('\n');
+                std::string_view line = text.substr(0, eol);
+                text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+                if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                if (line.empty() || line.front() == '#') continue;
+
+                // GUID, name, then target:source pairs
+                size_t field_index = 0;
+                std::optional<GamepadGuid> guid{};
+                GamepadMapping mapping{};
+                bool windows = true;
+                while (!line.empty())
+                {
+                    const size_t comma = line.find(',');
+                    const std::string_view field = line.substr(0, comma);
+                    line.remove_prefix(comma == std::string_view::npos ? line.size() : comma + 1);
+
+                    if (field_index++ == 0)
+                    {
+                        guid = ParseGuid(field);
+                        if (!guid) break;
+                        continue;
+                    }
+
+                    if (field.substr(0, 9) == "platform:")
+                        windows = field.substr(9) == "Windows";
+                    else
+                        mapping.BindField(field);
+                }
+
+                if (guid && windows)
+                {
+                    mappings_[*guid] = mapping;
+                    loaded++;
+                }
+            }
+
+            return loaded;
+        }
+
+        /// Finds the mapping of the GUID, falling back to the one without version.
+        [[nodiscard]] const GamepadMapping* Find(const GamepadGuid& guid) const
+        {
+            if (auto it = mappings_.find(guid); it != mappings_.end()) return &it->second;
+
+            GamepadGuid any_version = guid;
+            any_version[12] = any_version[13] = 0;
+            if (auto it = mappings_.find(any_version); it != mappings_.end()) return &it->second;
+
+            return nullptr;
+        }
+    };
+
+    /// Gamepad mapping compiled for a device: sources resolved to usage handles of the device.
+    struct GamepadRemap
+    {
+        struct Source
+        {
+            GamepadBinding Binding{};
+            HidUsageHandle Handle{};
+        };
+
+        std::array<Source, kStandardGamepadButtonCount> Buttons{};
+        std::array<std::array<Source, 2>, kStandardGamepadAxisCount> Axes{};
+
+        static GamepadRemap Compile(const HidDeviceCaps& caps, const GamepadMapping& mapping)
+        {
+            // Buttons by usage, non-hat values by page and usage, hats in cap order.
+            std::vector<HidUsageHandle> buttons;
+            std::vector<std::pair<uint32_t, HidUsageHandle>> axes;
+            std::vector<HidUsageHandle> hats;
+
+            std::vector<uint16_t> button_usages;
+            for (const HIDP_BUTTON_CAPS& cap : caps.ButtonCaps)
+            {
+                if (cap.UsagePage != HID_USAGE_PAGE_BUTTON) continue;
+                const USAGE first = cap.IsRange ? cap.Range.UsageMin : cap.NotRange.Usage;
+                const USAGE last = cap.IsRange ? cap.Range.UsageMax : cap.NotRange.Usage;
+                for (uint32_t u = first; u <= last && u - first < HidEvent::kMaxCountOfButtonsPerPage; u++)
+                    button_usages.push_back(static_cast<uint16_t>(u));
+            }
+            std::sort(button_usages.begin(), button_usages.end());
+            button_usages.erase(std::unique(button_usages.begin(), button_usages.end()), button_usages.end());
+            for (uint16_t u : button_usages)
+                buttons.push_back(caps.ButtonIndex.Find(HID_USAGE_PAGE_BUTTON, u));
+
+            for (size_t i = 0; i < caps.ValueCaps.size(); i++)
+            {
+                const HIDP_VALUE_CAPS& cap = caps.ValueCaps[i];
+                const HidUsageHandle h{static_cast<uint16_t>(i)};
+                if (cap.UsagePage == HID_USAGE_PAGE_GENERIC && cap.NotRange.Usage == HID_USAGE_GENERIC_HATSWITCH)
+                    hats.push_back(h);
+                else
+                    axes.emplace_back(UsageIndex::Key(cap.UsagePage, cap.NotRange.Usage), h);
+            }
+            std::stable_sort(axes.begin(), axes.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+            const auto resolve = [&](const GamepadBinding& b) -> Source
+            {
+                switch (b.Kind)
+                {
+                case GamepadBinding::SourceKind::Button: return {b, b.Index < buttons.size() ? buttons[b.Index] : HidUsageHandle{}};
+                case GamepadBinding::SourceKind::Axis: return {b, b.Index < axes.size() ? axes[b.Index].second : HidUsageHandle{}};
+                case GamepadBinding::SourceKind::Hat: return {b, b.Index < hats.size() ? hats[b.Index] : HidUsageHandle{}};
+                default: return {};
+                }
+            };
+
+            GamepadRemap r{};
+            for (size_t i = 0; i < r.Buttons.size(); i++)
+                r.Buttons[i] = resolve(mapping.Buttons[i]);
+            for (size_t i = 0; i < r.Axes.size(); i++)
+                r.Axes[i] = {resolve(mapping.Axes[i][0]), resolve(mapping.Axes[i][1])};
+            return r;
+        }
+    };
+
+    /// Maps an event through the compiled remap.
+    template <size_t TMaxCountOfValues, size_t TMaxCountOfButtonPages>
+    static StandardGamepadEvent MakeStandardGamepadEvent(const BasicHidEvent<TMaxCountOfValues, TMaxCountOfButtonPages>& e, const GamepadRemap& remap)
+    {
+        StandardGamepadEvent r{e.Device, e.Timestamp};
+
+        // full axis: -1.0 to +1.0, others: 0.0 to 1.0
+        const auto read = [&e](const GamepadRemap::Source& s) -> float
+        {
+            switch (s.Binding.Kind)
+            {
+            case GamepadBinding::SourceKind::Button:
+                return e.Button(s.Handle).value_or(false) ? 1.0f : 0.0f;
+
+            case GamepadBinding::SourceKind::Axis:
+            {
+                const HidValueInput* v = e.Value(s.Handle);
+                if (!v || v->MaxValue <= v->MinValue) return 0.0f;
+                const float center = (static_cast<float>(v->MinValue) + static_cast<float>(v->MaxValue)) / 2.0f;
+                const float half = (static_cast<float>(v->MaxValue) - static_cast<float>(v->MinValue)) / 2.0f;
+                float n = std::clamp((static_cast<float>(v->Value) - center) / half, -1.0f, 1.0f);
+                if (s.Binding.Invert) n = -n;
+                if (s.Binding.InputHalf) n = std::max(n * s.Binding.InputHalf, 0.0f);
+                return n;
+            }
+
+            case GamepadBinding::SourceKind::Hat:
+            {
+                // 8 directions clockwise from up; out of range is centered.
+                static constexpr uint8_t DIRECTIONS[8] = {1, 3, 2, 6, 4, 12, 8, 9};
+                const HidValueInput* v = e.Value(s.Handle);
+                if (!v) return 0.0f;
+                const int64_t range = static_cast<int64_t>(v->MaxValue) - v->MinValue + 1;
+                const int64_t position = static_cast<int64_t>(v->Value) - v->MinValue;
+                if (range <= 0 || position < 0 || position >= range) return 0.0f;
+                return DIRECTIONS[position * 8 / range] & s.Binding.HatMask ? 1.0f : 0.0f;
+            }
+
+            default:
+                return 0.0f;
+            }
+        };
+
+        for (size_t i = 0; i < remap.Buttons.size(); i++)
+            if (read(remap.Buttons[i]) > 0.5f)
+                r.Buttons |= 1u << i;
+
+        for (size_t i = 0; i < remap.Axes.size(); i++)
+        {
+            const auto& [full_or_negative, positive] = remap.Axes[i];
+            const bool trigger = i >= static_cast<size_t>(StandardGamepadAxis::LeftTrigger);
+            const bool full_axis_source = full_or_negative.Binding.Kind == GamepadBinding::SourceKind::Axis && !full_or_negative.Binding.InputHalf;
+
+            float n;
+            if (full_or_negative.Binding.OutputHalf == 0 && full_or_negative.Binding.Kind != GamepadBinding::SourceKind::None)
+                n = trigger && full_axis_source ? (read(full_or_negative) + 1.0f) / 2.0f : read(full_or_negative);
+            else
+                n = read(positive) - read(full_or_negative);
+
+            r.Axes[i] = static_cast<int16_t>(std::lround(std::clamp(n, trigger ? 0.0f : -1.0f, 1.0f) * 32767.0f));
+        }
+
+        return r;
+    }
+
+    /// Merges multi-axis controller reports into frames.
+    /// A frame is complete when every part (translation, rotation) has been updated once,
+    /// or is emitted as is when a part is updated twice before completion.
+    class MultiAxisTracker final
+    {
+        static inline constexpr uint32_t TRANSLATION = 1;
+        static inline constexpr uint32_t ROTATION = 2;
+
+        MultiAxisEvent frame_{};
+        uint32_t pending_{};
+
+    public:
+        template <class TEmit>
+        void Feed(const HidDeviceCaps& caps, HANDLE device, TIMESTAMP timestamp, PCHAR report, ULONG report_size, const std::array<float, 6>& sensitivity, TEmit&& emit)
+        {
+            const MultiAxisLayout& layout = caps.MultiAxis;
+            const PHIDP_PREPARSED_DATA preparsed = caps.PreparsedData();
+
+            uint32_t parts = 0;
+            uint32_t all_parts = 0;
+            std::array<std::optional<float>, 6> values{};
+            for (size_t i = 0; i < 6; i++)
+            {
+                const HidValueField& f = layout.Axes[i];
+                if (!f.Present) continue;
+                all_parts |= i < 3 ? TRANSLATION : ROTATION;
+
+                if (auto v = f.Read(preparsed, report, report_size))
+                {
+                    const float range = static_cast<float>(std::max(std::abs(static_cast<int64_t>(f.Min)), std::abs(static_cast<int64_t>(f.Max))));
+                    values[i] = range > 0 ? std::clamp(static_cast<float>(*v) / range, -1.0f, 1.0f) * sensitivity[i] : 0.0f;
+                    parts |= i < 3 ? TRANSLATION : ROTATION;
+                }
+            }
+
+            // Buttons are usually in their own report, and are delivered immediately.
+            USAGE pressed[32]{};
+            ULONG len = static_cast<ULONG>(std::size(pressed));
+            const bool has_buttons = layout.ButtonCount && ::HidP_GetUsages(HidP_Input, HID_USAGE_PAGE_BUTTON, 0, pressed, &len, preparsed, report, report_size) == HIDP_STATUS_SUCCESS;
+
+            if (parts & pending_)
+            {
+                emit(frame_);
+                pending_ = 0;
+            }
+
+            frame_.Device = device;
+            frame_.Timestamp = timestamp;
+            frame_.ButtonCount = layout.ButtonCount;
+            for (size_t i = 0; i < 6; i++)
+                if (values[i]) (i < 3 ? frame_.Translation[i] : frame_.Rotation[i - 3]) = *values[i];
+
+            if (has_buttons)
+            {
+                frame_.Buttons.reset();
+                for (ULONG i = 0; i < len; i++)
+                    if (pressed[i] >= 1 && pressed[i] <= 32)
+                        frame_.Buttons.set(pressed[i] - 1);
+            }
+
+            pending_ |= parts;
+            if ((pending_ && pending_ == all_parts) || has_buttons)
+            {
+                emit(frame_);
+                pending_ = 0;
+            }
+        }
+    };
+
+    class RawInputEventListenerImpl final
+    {
+        static inline constexpr UINT WM_REGISTER_DEVICE = WM_APP + 1;
+        static inline constexpr UINT WM_PROBE_WAKE_UP_LATENCY = WM_APP + 2;
+        static inline constexpr UINT WM_SET_BARCODE_SCANNER = WM_APP + 3;
+        static inline constexpr UINT_PTR IDLE_DETECTION_TIMER_ID = 1;
+        static inline constexpr UINT_PTR STAGE_TIMER_ID = 2;
+        static inline constexpr UINT STAGE_TIMER_INTERVAL_MS = 10; // tick of timer wheels of input stages
+        static inline constexpr UINT_PTR RECLAIM_TIMER_ID = 3;
+        static inline constexpr UINT RECLAIM_TIMER_INTERVAL_MS = 100; // retry of freeing retired caps while readers are pinned
+
+        struct CaptureStatistics
+        {
+            std::atomic<uint64_t> InputCount{};
+            std::atomic<uint64_t> WakeUpLatencySampleCount{};
+            std::atomic<TIMESTAMP> WakeUpLatencyMin{};
+            std::atomic<TIMESTAMP> WakeUpLatencyMax{};
+            std::atomic<TIMESTAMP> WakeUpLatencyTotal{};
+        };
+
+        struct DeviceActivity
+        {
+            TIMESTAMP LastInputTime{};
+            bool Idle{};
+        };
+
+        RawInputDeviceType target_device_types_{};
+        RawInputCallbacks callbacks_{};
+        TIMESTAMP device_idle_timeout_{};
+        ImuOrientationFilter imu_orientation_filter_{};
+        float imu_filter_gain_{};
+        std::array<float, 6> multi_axis_sensitivity_{};
+        CaptureStatistics statistics_{};
+        CapsEpochDomain epochs_{};
+        std::unordered_map<HANDLE, std::unique_ptr<HidDeviceCaps>> preparsed_data_cache_{};
+
+        // Per-device decoder states, capture thread only
+        std::unordered_map<HANDLE, TouchContactTracker> touch_trackers_{};
+        std::unordered_map<HANDLE, ARRAY<PenEvent, 64>> pen_batches_{};
+        std::unordered_map<HANDLE, ImuTracker> imu_trackers_{};
+        std::unordered_map<HANDLE, MultiAxisTracker> multi_axis_trackers_{};
+        std::unordered_map<HANDLE, WheelEvent> wheel_states_{}; // by the first device of the group
+        std::unordered_map<HANDLE, std::optional<GamepadRemap>> gamepad_remaps_{};
+        uint64_t gamepad_remaps_generation_{};
+        MouseGestureRecognizer mouse_gestures_;
+        MouseStrokeRecognizer mouse_strokes_;
+        BarcodeBurstAssembler barcode_bursts_;
+
+        CallbackDispatcher dispatcher_; // destructed first: drains queued events referring caps
+
+        // Input notification for WaitForInput: waiters sleep on the address of InputCount.
+        std::atomic<uint32_t> input_waiter_count_{};
+
+        // Gamepad mappings
+        mutable std::mutex gamepad_mappings_mutex_{};
+        GamepadMappingDatabase gamepad_mappings_{};
+        std::atomic<uint64_t> gamepad_mappings_generation_{};
+
+        // Key-state bitmaps of keyboards
+        mutable std::mutex keyboard_states_mutex_{};
+        std::unordered_map<HANDLE, KeyboardStateTracker> keyboard_states_{};
+
+        // Mouse wheel remainders and accumulations
+        mutable std::mutex mouse_states_mutex_{};
+        std::unordered_map<HANDLE, MouseStateTracker> mouse_states_{};
+
+        // Per-mouse cursors
+        mutable std::mutex cursors_mutex_{};
+        MultiCursorManager cursors_;
+
+        // Merged wheel devices
+        mutable std::mutex wheel_groups_mutex_{};
+        std::vector<std::vector<HANDLE>> wheel_groups_{};
+
+        // Idle detection
+        mutable std::mutex device_activity_mutex_{};
+        std::unordered_map<HANDLE, DeviceActivity> device_activity_{};
+        TIMESTAMP idle_detection_timer_deadline_{}; // 0: not armed
+        std::promise<void> ready_promise_{};
+        std::shared_future<void> ready_{ready_promise_.get_future().share()};
+
+        // Constructed last: the capture thread touches the members above as soon as it starts.
+        std::unique_ptr<ThreadedMessageWindow> message_window_{};
+
+    public:
+        RawInputEventListenerImpl(RawInputDeviceType target_device_types, RawInputCallbacks callbacks, RawInputListenerOptions options)
+            : target_device_types_(target_device_types)
+            , callbacks_(std::move(callbacks))
+            , device_idle_timeout_(options.DeviceIdleTimeout)
+            , imu_orientation_filter_(options.ImuOrientationFilter)
+            , imu_filter_gain_(options.ImuFilterGain)
+            , multi_axis_sensitivity_(options.MultiAxisSensitivity)
+            , mouse_gestures_(options.MouseGesture)
+            , mouse_strokes_(std::move(options.MouseStroke))
+            , barcode_bursts_(options.BarcodeScanner)
+            , dispatcher_(&epochs_, options.CallbackBudget, options.QueueOverrunningCallbacks, callbacks_.CallbackOverrunCallback)
+            , cursors_(options.Cursor)
+            , message_window_(std::make_unique<ThreadedMessageWindow>(
+                  "CLSRawInputEventListener",
+                  "WNDRawInputEventListener",
+                  [this]([[maybe_unused]] HWND hWnd,
+                         [[maybe_unused]] UINT uMsg,
+                         [[maybe_unused]] WPARAM wParam,
+                         [[maybe_unused]] LPARAM lParam) -> std::optional<LRESULT>
+                  {
+                      switch (uMsg)
+                      {
+                      case WM_REGISTER_DEVICE: return this->RegisterDevices(static_cast<DWORD>(wParam), reinterpret_cast<HWND>(lParam));
+                      case WM_INPUT: return this->ProcessWMInput(hWnd, reinterpret_cast<HRAWINPUT>(lParam));
+                      case WM_INPUT_DEVICE_CHANGE: return this->ProcessDeviceChange(hWnd, wParam, reinterpret_cast<HANDLE>(lParam));
+                      case WM_PROBE_WAKE_UP_LATENCY: return this->RecordWakeUpLatency(static_cast<uint32_t>(lParam));
+                      case WM_SET_BARCODE_SCANNER: return this->DesignateBarcodeScanner(reinterpret_cast<HANDLE>(lParam), wParam != 0);
+                      case WM_TIMER:
+                          if (wParam == IDLE_DETECTION_TIMER_ID) return this->DetectIdleDevices(hWnd);
+                          if (wParam == STAGE_TIMER_ID) return this->AdvanceStages(hWnd);
+                          if (wParam == RECLAIM_TIMER_ID) return this->ReclaimRetiredCaps(hWnd);
+                          return std::nullopt;
+                      default: return std::nullopt;
+                      }
+                  },
+                  [this](HWND hWnd) { this->Start(hWnd); },
+                  std::move(options.CaptureThread)))
+        {
+        }
+
+        ~RawInputEventListenerImpl()
+        {
+            // Stops event listening.
+            message_window_->PostMessageToWindow(WM_REGISTER_DEVICE, RIDEV_REMOVE, reinterpret_cast<LPARAM>(nullptr));
+        }
+
+        RawInputEventListenerImpl(const RawInputEventListenerImpl& other) = delete;
+        RawInputEventListenerImpl(RawInputEventListenerImpl&& other) noexcept = delete;
+        RawInputEventListenerImpl& operator=(const RawInputEventListenerImpl& other) = delete;
+        RawInputEventListenerImpl& operator=(RawInputEventListenerImpl&& other) noexcept = delete;
+
+        RawInputListenerStatistics Statistics() const
+        {
+            RawInputListenerStatistics r{};
+            r.InputCount = statistics_.InputCount.load(std::memory_order_relaxed);
+            r.SpinCount = message_window_->Statistics().SpinCount.load(std::memory_order_relaxed);
+            r.YieldCount = message_window_->Statistics().YieldCount.load(std::memory_order_relaxed);
+            r.BlockingWaitCount = message_window_->Statistics().BlockingWaitCount.load(std::memory_order_relaxed);
+            r.CpuTime = message_window_->ThreadCpuTime();
+            r.WallTime = Clock() - message_window_->StartTime();
+            r.WakeUpLatencySampleCount = statistics_.WakeUpLatencySampleCount.load(std::memory_order_relaxed);
+            r.WakeUpLatencyMin = statistics_.WakeUpLatencyMin.load(std::memory_order_relaxed);
+            r.WakeUpLatencyMax = statistics_.WakeUpLatencyMax.load(std::memory_order_relaxed);
+            if (r.WakeUpLatencySampleCount)
+                r.WakeUpLatencyAverage = static_cast<double>(statistics_.WakeUpLatencyTotal.load(std::memory_order_relaxed)) / static_cast<double>(r.WakeUpLatencySampleCount);
+            for (size_t i = 0; i < r.Callbacks.size(); i++)
+                r.Callbacks[i] = dispatcher_.Statistics(static_cast<RawInputCallbackKind>(i));
+            return r;
+        }
+
+        void ProbeWakeUpLatency()
+        {
+            // LPARAM is 32-bit on x86, so sends lower 32 bits of the clock, enough for measuring short intervals.
+            message_window_->PostMessageToWindow(WM_PROBE_WAKE_UP_LATENCY, 0, static_cast<LPARAM>(static_cast<uint32_t>(Clock())));
+        }
+
+        uint64_t WaitForInput(uint64_t last_sequence, TIMESTAMP timeout)
+        {
+            static_assert(sizeof(statistics_.InputCount) == sizeof(uint64_t) && std::atomic<uint64_t>::is_always_lock_free);
+            const TIMESTAMP deadline = timeout < 0 ? -1 : Clock() + timeout;
+            while (true)
+            {
+                if (uint64_t sequence = statistics_.InputCount.load(); sequence != last_sequence)
+                    return sequence;
+
+                DWORD wait_ms = INFINITE;
+                if (deadline >= 0)
+                {
+                    const TIMESTAMP remaining = deadline - Clock();
+                    if (remaining <= 0) return last_sequence;
+                    wait_ms = static_cast<DWORD>((remaining + 999) / 1000);
+                }
+
+                // The capture thread wakes only while someone is waiting.
+                // WaitOnAddress compares InputCount with last_sequence atomically with going to sleep,
+                // so an increment after registering as a waiter is never missed.
+                input_waiter_count_.fetch_add(1);
+                (void)::WaitOnAddress(&statistics_.InputCount, &last_sequence, sizeof(last_sequence), wait_ms);
+                input_waiter_count_.fetch_sub(1);
+            }
+        }
+
+        std::vector<RawInputDeviceActivity> DeviceActivities() const
+        {
+            std::lock_guard lock(device_activity_mutex_);
+            std::vector<RawInputDeviceActivity> result;
+            result.reserve(device_activity_.size());
+            for (auto&& [device, activity] : device_activity_)
+                result.push_back(RawInputDeviceActivity{device, activity.LastInputTime, activity.Idle});
+            return result;
+        }
+
+        size_t LoadGamepadMappings(std::string_view database)
+        {
+            std::lock_guard lock(gamepad_mappings_mutex_);
+            const size_t loaded = gamepad_mappings_.Load(database);
+            gamepad_mappings_generation_.fetch_add(1);
+            return loaded;
+        }
+
+        /// Gets the compiled gamepad remap of the device, compiling it on first use and after mappings are loaded.
+        const GamepadRemap* FindGamepadRemap(HANDLE device, const HidDeviceCaps& caps)
+        {
+            if (const uint64_t generation = gamepad_mappings_generation_.load(); generation != gamepad_remaps_generation_)
+            {
+                gamepad_remaps_.clear();
+                gamepad_remaps_generation_ = generation;
+            }
+
+            auto it = gamepad_remaps_.find(device);
+            if (it == gamepad_remaps_.end())
+            {
+                std::lock_guard lock(gamepad_mappings_mutex_);
+                static const GamepadMapping generic = GamepadMapping::FromFields(kGenericGamepadMapping);
+                const GamepadMapping* mapping = gamepad_mappings_.Find(caps.Guid);
+                if (!mapping && caps.HidPCaps.UsagePage == HID_USAGE_PAGE_GENERIC && caps.HidPCaps.Usage == HID_USAGE_GENERIC_GAMEPAD)
+                    mapping = &generic;
+                it = gamepad_remaps_.emplace(device, mapping ? std::optional<GamepadRemap>(GamepadRemap::Compile(caps, *mapping)) : std::nullopt).first;
+            }
+
+            return it->second ? &*it->second : nullptr;
+        }
+
+        RawInputKeyboardStatistics KeyboardStatistics(HANDLE device) const
+        {
+            std::lock_guard lock(keyboard_states_mutex_);
+            auto it = keyboard_states_.find(device);
+            return it != keyboard_states_.end() ? it->second.Statistics : RawInputKeyboardStatistics{};
+        }
+
+        RawInputMouseAccumulation DrainMouseAccumulation(HANDLE device)
+        {
+            RawInputMouseAccumulation r{};
+            std::lock_guard lock(mouse_states_mutex_);
+            for (auto&& [handle, state] : mouse_states_)
+            {
+                if (device && handle != device) continue;
+                const RawInputMouseAccumulation a = MouseStateTracker::Take(state.Accumulation);
+                r.EventCount += a.EventCount;
+                r.X += a.X;
+                r.Y += a.Y;
+                r.WheelDelta += a.WheelDelta;
+                r.HorizontalWheelDelta += a.HorizontalWheelDelta;
+                r.WheelNotches += a.WheelNotches;
+                r.HorizontalWheelNotches += a.HorizontalWheelNotches;
+                r.PressedButtons = static_cast<MouseEvent::ButtonIndex>(static_cast<uint32_t>(r.PressedButtons) | static_cast<uint32_t>(a.PressedButtons));
+                r.ReleasedButtons = static_cast<MouseEvent::ButtonIndex>(static_cast<uint32_t>(r.ReleasedButtons) | static_cast<uint32_t>(a.ReleasedButtons));
+                r.HeldButtons = static_cast<MouseEvent::ButtonIndex>(static_cast<uint32_t>(r.HeldButtons) | static_cast<uint32_t>(a.HeldButtons));
+                if (a.HasAbsolutePosition)
+                {
+                    r.HasAbsolutePosition = true;
+                    r.AbsoluteX = a.AbsoluteX;
+                    r.AbsoluteY = a.AbsoluteY;
+                }
+            }
+            return r;
+        }
+
+        std::vector<RawInputCursor> UpdateCursors()
+        {
+            std::lock_guard lock(cursors_mutex_);
+            cursors_.Update(Clock(), [this](auto&& visit)
+            {
+                std::lock_guard lock(mouse_states_mutex_);
+                for (auto&& [handle, state] : mouse_states_)
+                    visit(handle, MouseStateTracker::Take(state.CursorAccumulation));
+            });
+            return cursors_.Cursors();
+        }
+
+        void SetBarcodeScanner(HANDLE device, bool scanner)
+        {
+            message_window_->PostMessageToWindow(WM_SET_BARCODE_SCANNER, scanner ? 1 : 0, reinterpret_cast<LPARAM>(device));
+        }
+
+        void ConfigureCursor(HANDLE device, const RawInputCursorOptions& options)
+        {
+            std::lock_guard lock(cursors_mutex_);
+            cursors_.Configure(device, options);
+        }
+
+        void MergeWheelDevices(const std::vector<HANDLE>& devices)
+        {
+            std::lock_guard lock(wheel_groups_mutex_);
+            for (auto& group : wheel_groups_)
+                group.erase(std::remove_if(group.begin(), group.end(), [&](HANDLE d) { return std::find(devices.begin(), devices.end(), d) != devices.end(); }), group.end());
+            wheel_groups_.erase(std::remove_if(wheel_groups_.begin(), wheel_groups_.end(), [](const std::vector<HANDLE>& g) { return g.size() < 2; }), wheel_groups_.end());
+            if (devices.size() >= 2) wheel_groups_.push_back(devices);
+        }
+
+        [[nodiscard]] CapsEpochDomain& Epochs() { return epochs_; }
+
+        /// Gets the future which becomes ready when the listener has started.
+        [[nodiscard]] std::shared_future<void> Ready() const { return ready_; }
+
+    private:
+        /// Called on the capture thread before its message loop runs.
+        void Start(HWND hWnd)
+        {
+            // Starts event listening first, so that events are queued while enumerating devices.
+            (void)RegisterDevices(RIDEV_INPUTSINK, hWnd);
+
+            auto list = GetRawInputDeviceList(target_device_types_);
+            for (const auto& desc : list)
+                if (!preparsed_data_cache_.count(desc.Handle))
+                    preparsed_data_cache_[desc.Handle] = HidDeviceCaps::FromDevice(desc.Handle);
+
+            if (callbacks_.ListenerReadyCallback)
+            {
+                dispatcher_.InvokeCall(
+                    RawInputCallbackKind::ListenerReady,
+                    [&] { callbacks_.ListenerReadyCallback(); },
+                    [&] { return [this] { callbacks_.ListenerReadyCallback(); }; });
+            }
+
+            ready_promise_.set_value();
+        }
+
+        LRESULT ProcessDeviceChange(HWND hWnd, WPARAM change, HANDLE device)
+        {
+            if (change == GIDC_ARRIVAL)
+            {
+                // Device handles are not reused before removal is notified, so existing caps are still valid.
+                (void)FindDeviceCaps(device);
+            }
+
+            if (change == GIDC_REMOVAL)
+            {
+                // Queued or retained events may still refer the caps: retires them instead of freeing.
+                if (auto it = preparsed_data_cache_.find(device); it != preparsed_data_cache_.end())
+                {
+                    std::unique_ptr<HidDeviceCaps> caps = std::move(it->second);
+                    preparsed_data_cache_.erase(it);
+                    epochs_.Retire(std::move(caps));
+                }
+
+                // Pinned readers may hold back freeing: retries periodically until all are freed.
+                if (epochs_.HasRetired())
+                {
+                    (void)::SetTimer(hWnd, RECLAIM_TIMER_ID, RECLAIM_TIMER_INTERVAL_MS, nullptr);
+                }
+
+                touch_trackers_.erase(device);
+                imu_trackers_.erase(device);
+                multi_axis_trackers_.erase(device);
+                wheel_states_.erase(device);
+                gamepad_remaps_.erase(device);
+                mouse_gestures_.Remove(device);
+                mouse_strokes_.Remove(device);
+                barcode_bursts_.Remove(device, [this](const KeyboardEvent& k) { DispatchKeyboardEvent(k); });
+                {
+                    std::lock_guard lock(keyboard_states_mutex_);
+                    keyboard_states_.erase(device);
+                }
+                {
+                    std::lock_guard lock(mouse_states_mutex_);
+                    mouse_states_.erase(device);
+                }
+                if (auto it = pen_batches_.find(device); it != pen_batches_.end())
+                {
+                    FlushPenBatch(it->second);
+                    pen_batches_.erase(it);
+                }
+
+                std::lock_guard lock(device_activity_mutex_);
+                device_activity_.erase(device);
+            }
+
+            return 0;
+        }
+
+        /// Delivers batched pen samples.
+        template <size_t TCapacity>
+        void FlushPenBatch(ARRAY<PenEvent, TCapacity>& batch)
+        {
+            if (batch.empty()) return;
+
+            dispatcher_.InvokeCall(
+                RawInputCallbackKind::PenBatch,
+                [&] { callbacks_.PenEventBatchCallback(batch.data(), batch.size()); },
+                [&]
+                {
+                    auto copy = std::make_shared<std::vector<PenEvent>>(batch.begin(), batch.end());
+                    return [this, copy] { callbacks_.PenEventBatchCallback(copy->data(), copy->size()); };
+                });
+            batch.clear();
+        }
+
+        /// Gets device caps, building caps of the device on first use.
+        const HidDeviceCaps* FindDeviceCaps(HANDLE device)
+        {
+            auto it = preparsed_data_cache_.find(device);
+            if (it == preparsed_data_cache_.end())
+                it = preparsed_data_cache_.emplace(device, HidDeviceCaps::FromDevice(device)).first;
+            return it->second.get();
+        }
+
+        /// Marks the device active, and arms idle detection timer if needed.
+        void UpdateDeviceActivity(HWND hWnd, HANDLE device, TIMESTAMP now)
+        {
+            bool became_active = false;
+            {
+                std::lock_guard lock(device_activity_mutex_);
+                DeviceActivity& activity = device_activity_[device];
+                became_active = activity.Idle || activity.LastInputTime == 0;
+                activity.LastInputTime = now;
+                activity.Idle = false;
+            }
+
+            if (became_active && callbacks_.DeviceIdleStateCallback)
+            {
+                DispatchDeviceIdleState(device, false, now);
+            }
+
+            if (idle_detection_timer_deadline_ == 0)
+            {
+                ArmIdleDetectionTimer(hWnd, now + device_idle_timeout_, now);
+            }
+        }
+
+        void DispatchDeviceIdleState(HANDLE device, bool idle, TIMESTAMP now)
+        {
+            dispatcher_.InvokeCall(
+                RawInputCallbackKind::DeviceIdleState,
+                [&] { callbacks_.DeviceIdleStateCallback(device, idle, now); },
+                [&] { return [this, device, idle, now] { callbacks_.DeviceIdleStateCallback(device, idle, now); }; });
+        }
+
+        void ArmIdleDetectionTimer(HWND hWnd, TIMESTAMP deadline, TIMESTAMP now)
+        {
+            idle_detection_timer_deadline_ = deadline;
+            const UINT delay_ms = static_cast<UINT>(std::max<TIMESTAMP>((deadline - now + 999) / 1000, USER_TIMER_MINIMUM));
+            (void)::SetTimer(hWnd, IDLE_DETECTION_TIMER_ID, delay_ms, nullptr);
+        }
+
+        /// Called on the idle detection timer. The timer stays armed only while some devices are active.
+        LRESULT DetectIdleDevices(HWND hWnd)
+        {
+            const TIMESTAMP now = Clock();
+            TIMESTAMP next_deadline = 0;
+            ARRAY<HANDLE, 16> became_idle;
+            {
+                std::lock_guard lock(device_activity_mutex_);
+                for (auto&& [device, activity] : device_activity_)
+                {
+                    if (activity.Idle) continue;
+
+                    const TIMESTAMP deadline = activity.LastInputTime + device_idle_timeout_;
+                    if (deadline <= now && became_idle.size() < became_idle.capacity())
+                    {
+                        activity.Idle = true;
+                        became_idle.push_back(device);
+                    }
+                    else if (next_deadline == 0 || deadline < next_deadline)
+                    {
+                        next_deadline = deadline;
+                    }
+                }
+            }
+
+            if (callbacks_.DeviceIdleStateCallback)
+            {
+                for (HANDLE device : became_idle)
+                    DispatchDeviceIdleState(device, true, now);
+            }
+
+            if (next_deadline != 0)
+            {
+                ArmIdleDetectionTimer(hWnd, next_deadline, now);
+            }
+            else
+            {
+                (void)::KillTimer(hWnd, IDLE_DETECTION_TIMER_ID);
+                idle_detection_timer_deadline_ = 0;
+            }
+
+            return 0;
+        }
+
+        [[nodiscard]] bool StageTimersPending() const { return mouse_gestures_.HasPendingTimers() || mouse_strokes_.HasPendingTimers() || barcode_bursts_.HasPendingTimers(); }
+
+        void ArmStageTimer(HWND hWnd, bool armed)
+        {
+            if (!armed && StageTimersPending())
+                (void)::SetTimer(hWnd, STAGE_TIMER_ID, STAGE_TIMER_INTERVAL_MS, nullptr);
+        }
+
+        void AdvanceStages(TIMESTAMP now)
+        {
+            mouse_gestures_.Advance(now, [this](const MouseGestureEvent& g) { dispatcher_.Invoke(RawInputCallbackKind::MouseGesture, callbacks_.MouseGestureEventCallback, g); });
+            mouse_strokes_.Advance(now, [this](const MouseStrokeEvent& g) { dispatcher_.Invoke(RawInputCallbackKind::MouseStroke, callbacks_.MouseStrokeEventCallback, g); });
+            barcode_bursts_.Advance(now, [this](const BarcodeEvent& b) { dispatcher_.Invoke(RawInputCallbackKind::Barcode, callbacks_.BarcodeEventCallback, b); }, [this](const KeyboardEvent& k) { DispatchKeyboardEvent(k); });
+        }
+
+        /// Delivers a key to the key-state bitmap and KeyboardEvent.
+        void DispatchKeyboardEvent(const KeyboardEvent& e)
+        {
+            {
+                std::lock_guard lock(keyboard_states_mutex_);
+                keyboard_states_[e.Device].Feed(e.RawKeyboard);
+            }
+
+            if (callbacks_.KeyboardEventCallback)
+                dispatcher_.Invoke(RawInputCallbackKind::Keyboard, callbacks_.KeyboardEventCallback, e);
+        }
+
+        LRESULT DesignateBarcodeScanner(HANDLE device, bool scanner)
+        {
+            barcode_bursts_.Designate(device, scanner, [this](const KeyboardEvent& k) { DispatchKeyboardEvent(k); });
+            return 0;
+        }
+
+        /// Called on the stage timer. The timer stays armed only while click sequences, strokes or bursts are pending.
+        LRESULT AdvanceStages(HWND hWnd)
+        {
+            AdvanceStages(Clock());
+            if (!StageTimersPending())
+                (void)::KillTimer(hWnd, STAGE_TIMER_ID);
+            return 0;
+        }
+
+        LRESULT RecordWakeUpLatency(uint32_t posted_time)
+        {
+            const TIMESTAMP latency = static_cast<TIMESTAMP>(static_cast<uint32_t>(Clock()) - posted_time);
+
+            // Written only by capture thread.
+            const uint64_t count = statistics_.WakeUpLatencySampleCount.load(std::memory_order_relaxed);
+            if (count == 0 || latency < statistics_.WakeUpLatencyMin.load(std::memory_order_relaxed)) statistics_.WakeUpLatencyMin.store(latency, std::memory_order_relaxed);
+            if (count == 0 || latency > statistics_.WakeUpLatencyMax.load(std::memory_order_relaxed)) statistics_.WakeUpLatencyMax.store(latency, std::memory_order_relaxed);
+            statistics_.WakeUpLatencyTotal.fetch_add(latency, std::memory_order_relaxed);
+            statistics_.WakeUpLatencySampleCount.store(count + 1, std::memory_order_relaxed);
+            return 0;
+        }
+
+        LRESULT RegisterDevices(DWORD flags, HWND target)
+        {
+            // Receives WM_INPUT_DEVICE_CHANGE to track device removal.
+            if (!(flags & RIDEV_REMOVE)) flags |= RIDEV_DEVNOTIFY;
+
+            ARRAY<RAWINPUTDEVICE, 16> v;
+            using DevType = RawInputDeviceType;
+            if (!!(target_device_types_ & DevType::Other)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_POINTER, flags, target});
+            if (!!(target_device_types_ & DevType::Mouse)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_MOUSE, flags, target});
+            if (!!(target_device_types_ & DevType::Keyboard)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_KEYBOARD, flags, target});
+            if (!!(target_device_types_ & DevType::Joystick)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_JOYSTICK, flags, target});
+            if (!!(target_device_types_ & DevType::GamePad)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_GAMEPAD, flags, target});
+            if (!!(target_device_types_ & DevType::Other)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_KEYPAD, flags, target});
+            if (!!(target_device_types_ & (DevType::Other | DevType::MultiAxis))) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_MULTI_AXIS_CONTROLLER, flags, target});
+            if (!!(target_device_types_ & DevType::Digitizer)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_DIGITIZER, HID_USAGE_DIGITIZER_PEN, flags, target});
+            if (!!(target_device_types_ & DevType::Digitizer)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_DIGITIZER, HID_USAGE_DIGITIZER_TOUCH_SCREEN, flags, target});
+            if (!!(target_device_types_ & DevType::Digitizer)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_DIGITIZER, HID_USAGE_DIGITIZER_TOUCH_PAD, flags, target});
+            if (!!(target_device_types_ & DevType::ConsumerControl)) v.push_back(RAWINPUTDEVICE{HID_USAGE_PAGE_CONSUMER, HID_USAGE_CONSUMERCTRL, flags, target});
+
+            if (BOOL rel = ::RegisterRawInputDevices(v.data(), static_cast<UINT>(v.size()), sizeof(RAWINPUTDEVICE)); !rel)
+            {
+                ::OutputDebugStringA("Failed to RegisterRawInputDevices(...)");
+                if (::IsDebuggerPresent()) ::DebugBreak();
+                return 1;
+            }
+
+            return 0;
+        }
+
+        LRESULT ReclaimRetiredCaps(HWND hWnd)
+        {
+            epochs_.Reclaim();
+            if (!epochs_.HasRetired())
+            {
+                (void)::KillTimer(hWnd, RECLAIM_TIMER_ID);
+            }
+            return 0;
+        }
+
+        LRESULT ProcessWMInput(HWND hWnd, HRAWINPUT hRawInput)
+        {
+            TIMESTAMP now = Clock();
+
+            // get input data
+            auto input_data_buffer = [stack_buf = std::array<std::byte, 4096>(), heap_buf = std::unique_ptr<std::byte[]>()](HRAWINPUT hRawInput) mutable -> RAWINPUT*
+            {
+                void* buffer = stack_buf.data();
+                UINT size = static_cast<UINT>(stack_buf.size());
+                UINT result = ::GetRawInputData(hRawInput, RID_INPUT, buffer, &size, sizeof(RAWINPUTHEADER));
+
+                // If stack_buf is not enough to store data, allocate heap_buf dynamically.
+                if (result == static_cast<UINT>(-1))
+                {
+                    if (UINT required = 0; ::GetRawInputData(hRawInput, RID_INPUT, nullptr, &required, sizeof(RAWINPUTHEADER)) == 0)
+                    {
+                        heap_buf = std::make_unique<std::byte[]>(required);
+                        buffer = heap_buf.get();
+                        size = required;
+                        result = ::GetRawInputData(hRawInput, RID_INPUT, buffer, &size, sizeof(RAWINPUTHEADER));
+                    }
+                }
+
+                // Failed...?
+                if (result == static_cast<UINT>(-1))
+                {
+                    ::OutputDebugStringA("Failed to GetRawInputData(...)\n");
+                    if (::IsDebuggerPresent()) ::DebugBreak();
+                    return nullptr;
+                }
+
+                return static_cast<RAWINPUT*>(buffer);
+            };
+
+            RAWINPUT* data = input_data_buffer(hRawInput);
+            if (!data) return 0;
+
+            if (device_idle_timeout_ > 0)
+            {
+                UpdateDeviceActivity(hWnd, data->header.hDevice, now);
+            }
+
+            // Raises input event callback.
+
+            if (callbacks_.RawInputEventCallback)
+            {
+                dispatcher_.InvokeCall(
+                    RawInputCallbackKind::RawInput,
+                    [&] { callbacks_.RawInputEventCallback(data, now); },
+                    [&]
+                    {
+                        // Copies RAWINPUT for queued delivery.
+                        auto copy = std::make_shared<std::vector<std::byte>>(reinterpret_cast<const std::byte*>(data), reinterpret_cast<const std::byte*>(data) + data->header.dwSize);
+                        return [this, copy, now] { callbacks_.RawInputEventCallback(reinterpret_cast<const RAWINPUT*>(copy->data()), now); };
+                    });
+            }
+
+            if (data->header.dwType == RIM_TYPEKEYBOARD)
+            {
+                KeyboardEvent e = KeyboardEvent::Parse(data, now);
+                if (callbacks_.BarcodeEventCallback)
+                {
+                    const bool timer_armed = StageTimersPending();
+                    AdvanceStages(now);
+                    const bool held = barcode_bursts_.Feed(
+                        e, now,
+                        [this](const BarcodeEvent& b) { dispatcher_.Invoke(RawInputCallbackKind::Barcode, callbacks_.BarcodeEventCallback, b); },
+                        [this](const KeyboardEvent& k) { DispatchKeyboardEvent(k); });
+                    if (!held) DispatchKeyboardEvent(e);
+                    ArmStageTimer(hWnd, timer_armed);
+                }
+                else
+                {
+                    DispatchKeyboardEvent(e);
+                }
+            }
+
+            if (data->header.dwType == RIM_TYPEMOUSE)
+            {
+                MouseEvent e = MouseEvent::Parse(data, now);
+                {
+                    std::lock_guard lock(mouse_states_mutex_);
+                    mouse_states_[data->header.hDevice].Feed(e);
+                }
+
+                if (callbacks_.MouseEventCallback)
+                    dispatcher_.Invoke(RawInputCallbackKind::Mouse, callbacks_.MouseEventCallback, e);
+
+                if (callbacks_.MouseGestureEventCallback || callbacks_.MouseStrokeEventCallback)
+                {
+                    const bool timer_armed = StageTimersPending();
+                    AdvanceStages(now);
+                    if (callbacks_.MouseGestureEventCallback)
+                        mouse_gestures_.Feed(e, now, [this](const MouseGestureEvent& g) { dispatcher_.Invoke(RawInputCallbackKind::MouseGesture, callbacks_.MouseGestureEventCallback, g); });
+                    if (callbacks_.MouseStrokeEventCallback)
+                        mouse_strokes_.Feed(e, now, [this](const MouseStrokeEvent& g) { dispatcher_.Invoke(RawInputCallbackKind::MouseStroke, callbacks_.MouseStrokeEventCallback, g); });
+                    ArmStageTimer(hWnd, timer_armed);
+                }
+            }
+
+            if ((callbacks_.HidEventCallback || callbacks_.SmallHidEventCallback || callbacks_.LargeHidEventCallback
+                    || callbacks_.JoystickHidEventCallback || callbacks_.FixedJoystickHidEventCallback || callbacks_.StandardGamepadEventCallback)
+                && data->header.dwType == RIM_TYPEHID)
+            {
+                if (const HidDeviceCaps* caps = FindDeviceCaps(data->header.hDevice))
+                {
+                    // Joystick events are made from LargeHidEvent only for devices which do not fit in HidEvent.
+                    const bool large_device = caps->ValueCaps.size() > HidEvent::kMaxCountOfValues || caps->ButtonCaps.size() > HidEvent::kMaxCountOfButtonPages;
+                    const GamepadRemap* gamepad_remap = callbacks_.StandardGamepadEventCallback ? FindGamepadRemap(data->header.hDevice, *caps) : nullptr;
+                    const bool joystick = callbacks_.JoystickHidEventCallback || callbacks_.FixedJoystickHidEventCallback || gamepad_remap;
+
+                    const auto dispatch_joystick = [this, gamepad_remap](const auto& e)
+                    {
+                        if (gamepad_remap)
+                        {
+                            StandardGamepadEvent r = MakeStandardGamepadEvent(e, *gamepad_remap);
+                            dispatcher_.Invoke(RawInputCallbackKind::StandardGamepad, callbacks_.StandardGamepadEventCallback, r);
+                        }
+
+                        if (callbacks_.JoystickHidEventCallback)
+                        {
+                            JoystickHidEvent r = JoystickHidEvent::FromHidEvent(e);
+                            dispatcher_.Invoke(RawInputCallbackKind::JoystickHid, callbacks_.JoystickHidEventCallback, r);
+                        }
+
+                        if (callbacks_.FixedJoystickHidEventCallback)
+                        {
+                            FixedJoystickHidEvent r = FixedJoystickHidEvent::FromHidEvent(e);
+                            dispatcher_.Invoke(RawInputCallbackKind::FixedJoystickHid, callbacks_.FixedJoystickHidEventCallback, r);
+                        }
+                    };
+
+                    if (callbacks_.SmallHidEventCallback)
+                    {
+                        SmallHidEvent e = SmallHidEvent::Parse(data, now, caps);
+                        dispatcher_.Invoke(RawInputCallbackKind::SmallHid, callbacks_.SmallHidEventCallback, e);
+                    }
+
+                    if (callbacks_.HidEventCallback || (joystick && !large_device))
+                    {
+                        HidEvent e = HidEvent::Parse(data, now, caps);
+                        if (callbacks_.HidEventCallback)
+                        {
+                            dispatcher_.Invoke(RawInputCallbackKind::Hid, callbacks_.HidEventCallback, e);
+                        }
+
+                        if (joystick && !large_device)
+                        {
+                            dispatch_joystick(e);
+                        }
+                    }
+
+                    if (callbacks_.LargeHidEventCallback || (joystick && large_device))
+                    {
+                        LargeHidEvent e = LargeHidEvent::Parse(data, now, caps);
+                        if (callbacks_.LargeHidEventCallback)
+                        {
+                            dispatcher_.Invoke(RawInputCallbackKind::LargeHid, callbacks_.LargeHidEventCallback, e);
+                        }
+
+                        if (joystick && large_device)
+                        {
+                            dispatch_joystick(e);
+                        }
+                    }
+                }
+            }
+
+            if (callbacks_.TouchEventCallback && data->header.dwType == RIM_TYPEHID)
+            {
+                if (const HidDeviceCaps* caps = FindDeviceCaps(data->header.hDevice); caps && !caps->Digitizer.Contacts.empty())
+                {
+                    // A message may contain several reports.
+                    TouchContactTracker& tracker = touch_trackers_[data->header.hDevice];
+                    const auto report_size = data->data.hid.dwSizeHid;
+                    for (DWORD i = 0; i < data->data.hid.dwCount; i++)
+                    {
+                        const auto report = reinterpret_cast<PCHAR>(data->data.hid.bRawData + static_cast<size_t>(i) * report_size);
+                        tracker.Feed(data->header.hDevice, now, ParseTouchReport(*caps, report, report_size), [this](const TouchEvent& e)
+                        {
+                            dispatcher_.Invoke(RawInputCallbackKind::Touch, callbacks_.TouchEventCallback, e);
+                        });
+                    }
+                }
+            }
+
+            if ((callbacks_.PenEventCallback || callbacks_.PenEventBatchCallback) && data->header.dwType == RIM_TYPEHID)
+            {
+                if (const HidDeviceCaps* caps = FindDeviceCaps(data->header.hDevice); caps && caps->Digitizer.Stylus)
+                {
+                    const auto report_size = data->data.hid.dwSizeHid;
+                    for (DWORD i = 0; i < data->data.hid.dwCount; i++)
+                    {
+                        const auto report = reinterpret_cast<PCHAR>(data->data.hid.bRawData + static_cast<size_t>(i) * report_size);
+                        const std::optional<PenEvent> e = ParsePenReport(*caps, data->header.hDevice, now, report, report_size);
+                        if (!e) continue;
+
+                        if (callbacks_.PenEventCallback)
+                        {
+                            dispatcher_.Invoke(RawInputCallbackKind::Pen, callbacks_.PenEventCallback, *e);
+                        }
+
+                        if (callbacks_.PenEventBatchCallback)
+                        {
+                            // A batch ends at tip down/up, so that a stroke is a contiguous span.
+                            auto& batch = pen_batches_[data->header.hDevice];
+                            if (!batch.empty() && (batch.end() - 1)->Tip != e->Tip) FlushPenBatch(batch);
+                            batch.push_back(*e);
+                            if (batch.size() == batch.capacity()) FlushPenBatch(batch);
+                        }
+                    }
+                }
+            }
+
+            if (callbacks_.ConsumerControlEventCallback && data->header.dwType == RIM_TYPEHID)
+            {
+                if (const HidDeviceCaps* caps = FindDeviceCaps(data->header.hDevice); caps && caps->ConsumerControl.Present)
+                {
+                    const auto report_size = data->data.hid.dwSizeHid;
+                    for (DWORD i = 0; i < data->data.hid.dwCount; i++)
+                    {
+                        const auto report = reinterpret_cast<PCHAR>(data->data.hid.bRawData + static_cast<size_t>(i) * report_size);
+                        ConsumerControlEvent e = ParseConsumerControlReport(*caps, data->header.hDevice, now, report, report_size);
+                        dispatcher_.Invoke(RawInputCallbackKind::ConsumerControl, callbacks_.ConsumerControlEventCallback, e);
+                    }
+                }
+            }
+
+            if (callbacks_.ImuEventCallback && data->header.dwType == RIM_TYPEHID)
+            {
+                if (const HidDeviceCaps* caps = FindDeviceCaps(data->header.hDevice); caps && (caps->Imu.HasAcceleration() || caps->Imu.HasAngularVelocity()))
+                {
+                    ImuTracker& tracker = imu_trackers_[data->header.hDevice];
+                    const auto report_size = data->data.hid.dwSizeHid;
+                    const auto report_count = data->data.hid.dwCount;
+                    for (DWORD i = 0; i < report_count; i++)
+                    {
+                        const auto report = reinterpret_cast<PCHAR>(data->data.hid.bRawData + static_cast<size_t>(i) * report_size);
+                        const TIMESTAMP timestamp = tracker.ReportTime(now, i, report_count);
+                        std::optional<ImuEvent> e = ParseImuReport(*caps, data->header.hDevice, timestamp, report, report_size);
+                        if (!e) continue;
+
+                        tracker.Update(*e, imu_orientation_filter_, imu_filter_gain_);
+                        dispatcher_.Invoke(RawInputCallbackKind::Imu, callbacks_.ImuEventCallback, *e);
+                    }
+                }
+            }
+
+            if (callbacks_.MultiAxisEventCallback && data->header.dwType == RIM_TYPEHID)
+            {
+                if (const HidDeviceCaps* caps = FindDeviceCaps(data->header.hDevice); caps && caps->MultiAxis.Present)
+                {
+                    MultiAxisTracker& tracker = multi_axis_trackers_[data->header.hDevice];
+                    const auto report_size = data->data.hid.dwSizeHid;
+                    for (DWORD i = 0; i < data->data.hid.dwCount; i++)
+                    {
+                        const auto report = reinterpret_cast<PCHAR>(data->data.hid.bRawData + static_cast<size_t>(i) * report_size);
+                        tracker.Feed(*caps, data->header.hDevice, now, report, report_size, multi_axis_sensitivity_, [this](const MultiAxisEvent& e)
+                        {
+                            dispatcher_.Invoke(RawInputCallbackKind::MultiAxis, callbacks_.MultiAxisEventCallback, e);
+                        });
+                    }
+                }
+            }
+
+            if (callbacks_.WheelEventCallback && data->header.dwType == RIM_TYPEHID)
+            {
+                if (const HidDeviceCaps* caps = FindDeviceCaps(data->header.hDevice); caps && caps->Wheel.Present)
+                {
+                    // Merged devices share the state of the first device; buttons follow those of the preceding devices.
+                    HANDLE group_device = data->header.hDevice;
+                    uint32_t button_offset = 0;
+                    {
+                        std::lock_guard lock(wheel_groups_mutex_);
+                        for (const auto& group : wheel_groups_)
+                        {
+                            if (std::find(group.begin(), group.end(), data->header.hDevice) == group.end()) continue;
+                            group_device = group.front();
+                            for (HANDLE d : group)
+                            {
+                                if (d == data->header.hDevice) break;
+                                if (const HidDeviceCaps* c = FindDeviceCaps(d)) button_offset += c->Wheel.ButtonCount;
+                            }
+                            break;
+                        }
+                    }
+
+                    WheelEvent& state = wheel_states_[group_device];
+                    state.Device = group_device;
+                    state.ButtonCount = std::max(state.ButtonCount, std::min<uint32_t>(button_offset + caps->Wheel.ButtonCount, 64));
+
+                    const auto report_size = data->data.hid.dwSizeHid;
+                    for (DWORD i = 0; i < data->data.hid.dwCount; i++)
+                    {
+                        const auto report = reinterpret_cast<PCHAR>(data->data.hid.bRawData + static_cast<size_t>(i) * report_size);
+                        if (!DecodeWheelReport(*caps, report, report_size, button_offset, state)) continue;
+
+                        state.Timestamp = now;
+                        dispatcher_.Invoke(RawInputCallbackKind::Wheel, callbacks_.WheelEventCallback, state);
+                    }
+                }
+            }
+
+            // Delivers pen batches at the end of a burst of input.
+            if (callbacks_.PenEventBatchCallback && !(HIWORD(::GetQueueStatus(QS_RAWINPUT)) & QS_RAWINPUT))
+            {
+                for (auto&& [device, batch] : pen_batches_)
+                    FlushPenBatch(batch);
+            }
+
+            // Frees retired caps whose readers have left during the dispatch.
+            epochs_.Reclaim();
+
+            // Wakes up WaitForRawInput callers.
+            statistics_.InputCount.fetch_add(1);
+            if (input_waiter_count_.load() != 0)
+            {
+                ::WakeByAddressAll(&statistics_.InputCount);
+            }
+
+            return 0;
+        }
+    };
+
+    std::shared_ptr<void> StartRawInput(RawInputDeviceType target_device_types, RawInputCallbacks callbacks)
+    {
+        return StartRawInput(target_device_types, std::move(callbacks), RawInputListenerOptions{});
+    }
+
+    std::shared_ptr<void> StartRawInput(RawInputDeviceType target_device_types, RawInputCallbacks callbacks, RawInputListenerOptions options)
+    {
+        RawInputAsyncStart started = StartRawInputAsync(target_device_types, std::move(callbacks), std::move(options));
+        started.Ready.wait();
+        return std::move(started.Listener);
+    }
+
+    RawInputAsyncStart StartRawInputAsync(RawInputDeviceType target_device_types, RawInputCallbacks callbacks, RawInputListenerOptions options)
+    {
+        auto listener = std::make_shared<RawInputEventListenerImpl>(target_device_types, std::move(callbacks), std::move(options));
+        auto ready = listener->Ready();
+        return RawInputAsyncStart{std::move(listener), std::move(ready)};
+    }
+
+    RawInputListenerStatistics GetRawInputListenerStatistics(const std::shared_ptr<void>& listener)
+    {
+        if (!listener) return {};
+        return static_cast<const RawInputEventListenerImpl*>(listener.get())->Statistics();
+    }
+
+    RawInputKeyboardStatistics GetRawInputKeyboardStatistics(const std::shared_ptr<void>& listener, HANDLE device)
+    {
+        if (!listener) return {};
+        return static_cast<const RawInputEventListenerImpl*>(listener.get())->KeyboardStatistics(device);
+    }
+
+    RawInputMouseAccumulation DrainRawInputMouseAccumulation(const std::shared_ptr<void>& listener, HANDLE device)
+    {
+        if (!listener) return {};
+        return static_cast<RawInputEventListenerImpl*>(listener.get())->DrainMouseAccumulation(device);
+    }
+
+    std::vector<RawInputCursor> UpdateRawInputCursors(const std::shared_ptr<void>& listener)
+    {
+        if (!listener) return {};
+        return static_cast<RawInputEventListenerImpl*>(listener.get())->UpdateCursors();
+    }
+
+    void ConfigureRawInputCursor(const std::shared_ptr<void>& listener, HANDLE device, const RawInputCursorOptions& options)
+    {
+        if (!listener) return;
+        static_cast<RawInputEventListenerImpl*>(listener.get())->ConfigureCursor(device, options);
+    }
+
+    void SetRawInputBarcodeScanner(const std::shared_ptr<void>& listener, HANDLE device, bool scanner)
+    {
+        if (!listener) return;
+        static_cast<RawInputEventListenerImpl*>(listener.get())->SetBarcodeScanner(device, scanner);
+    }
+
+    void ProbeRawInputWakeUpLatency(const std::shared_ptr<void>& listener)
+    {
+        if (!listener) return;
+        static_cast<RawInputEventListenerImpl*>(listener.get())->ProbeWakeUpLatency();
+    }
+
+    uint64_t WaitForRawInput(const std::shared_ptr<void>& listener, uint64_t last_sequence, TIMESTAMP timeout)
+    {
+        if (!listener) return last_sequence;
+        return static_cast<RawInputEventListenerImpl*>(listener.get())->WaitForInput(last_sequence, timeout);
+    }
+
+    std::vector<RawInputDeviceActivity> GetRawInputDeviceActivity(const std::shared_ptr<void>& listener)
+    {
+        if (!listener) return {};
+        return static_cast<const RawInputEventListenerImpl*>(listener.get())->DeviceActivities();
+    }
+
+    size_t LoadRawInputGamepadMappings(const std::shared_ptr<void>& listener, std::string_view database)
+    {
+        if (!listener) return 0;
+        return static_cast<RawInputEventListenerImpl*>(listener.get())->LoadGamepadMappings(database);
+    }
+
+    void MergeRawInputWheelDevices(const std::shared_ptr<void>& listener, const std::vector<HANDLE>& devices)
+    {
+        if (!listener) return;
+        static_cast<RawInputEventListenerImpl*>(listener.get())->MergeWheelDevices(devices);
+    }
+
+    RawInputEpochGuard::RawInputEpochGuard(std::shared_ptr<void> listener)
+        : listener_(std::move(listener))
+        , slot_(listener_ ? static_cast<RawInputEventListenerImpl*>(listener_.get())->Epochs().Enter() : CapsEpochDomain::kInvalidSlot)
+    {
+    }
+
+    RawInputEpochGuard::~RawInputEpochGuard()
+    {
+        if (listener_ && slot_ != CapsEpochDomain::kInvalidSlot)
+            static_cast<RawInputEventListenerImpl*>(listener_.get())->Epochs().Leave(slot_);
+    }
+
+    RawInputEpochGuard::RawInputEpochGuard(RawInputEpochGuard&& other) noexcept
+        : listener_(std::move(other.listener_))
+        , slot_(std::exchange(other.slot_, CapsEpochDomain::kInvalidSlot))
+    {
+    }
+
+    KeyboardEvent KeyboardEvent::Parse(const RAWINPUT* input, TIMESTAMP timestamp)
+    {
+        KeyboardEvent e{};
+        e.Device = input->header.hDevice;
+        e.Timestamp = timestamp;
+        e.RawKeyboard = input->data.keyboard;
+        return e;
+    }
+
+    MouseEvent MouseEvent::Parse(const RAWINPUT* input, TIMESTAMP timestamp)
+    {
+        MouseEvent e{};
+        e.Device = input->header.hDevice;
         e.Timestamp = timestamp;
         e.RawMouse = input->data.mouse;
         return e;
@@ -465,6 +3069,27 @@ namespace ttsuki::librawinput
             return nullptr;
         }
 
+        // Bluetooth devices are told by the service class in the device path.
+        {
+            RID_DEVICE_INFO info{};
+            info.cbSize = sizeof(info);
+            UINT info_size = sizeof(info);
+            std::array<wchar_t, 1024> name{};
+            UINT name_size = static_cast<UINT>(name.size());
+            if (::GetRawInputDeviceInfoW(device, RIDI_DEVICEINFO, &info, &info_size) != static_cast<UINT>(-1) && info.dwType == RIM_TYPEHID
+                && ::GetRawInputDeviceInfoW(device, RIDI_DEVICENAME, name.data(), &name_size) != static_cast<UINT>(-1))
+            {
+                std::wstring path = name.data();
+                std::transform(path.begin(), path.end(), path.begin(), [](wchar_t c) { return static_cast<wchar_t>(::towlower(c)); });
+                const bool bluetooth = path.find(L"{00001124-0000-1000-8000-00805f9b34fb}") != std::wstring::npos // HID
+                    || path.find(L"{00001812-0000-1000-8000-00805f9b34fb}") != std::wstring::npos;                // HID over GATT
+                caps->Guid = MakeGamepadGuid(bluetooth ? 0x05 : 0x03,
+                                             static_cast<uint16_t>(info.hid.dwVendorId),
+                                             static_cast<uint16_t>(info.hid.dwProductId),
+                                             static_cast<uint16_t>(info.hid.dwVersionNumber));
+            }
+        }
+
         caps->PreparsedDataBlob = std::make_unique<std::byte[]>(buf_size);
         if (UINT expected = buf_size;
             ::GetRawInputDeviceInfoW(device, RIDI_PREPARSEDDATA, caps->PreparsedDataBlob.get(), &buf_size) != expected)
@@ -490,6 +3115,53 @@ namespace ttsuki::librawinput
                     caps->ButtonCaps.resize(size);
                     (void)::HidP_GetButtonCaps(HidP_Input, caps->ButtonCaps.data(), &size, preparsed);
                 }
+
+                std::vector<UsageIndex::Entry> values;
+                for (size_t i = 0; i < caps->ValueCaps.size(); i++)
+                {
+                    const HIDP_VALUE_CAPS& cap = caps->ValueCaps[i];
+                    values.push_back({UsageIndex::Key(cap.UsagePage, cap.NotRange.Usage), static_cast<uint16_t>(i)});
+                }
+                caps->ValueIndex.Build(values);
+
+                // Buttons are indexed by usage within the first 64 of each cap, as parsed into HidEvent.
+                std::vector<UsageIndex::Entry> buttons;
+                for (size_t i = 0; i < caps->ButtonCaps.size(); i++)
+                {
+                    const HIDP_BUTTON_CAPS& cap = caps->ButtonCaps[i];
+                    const USAGE first = cap.IsRange ? cap.Range.UsageMin : cap.NotRange.Usage;
+                    const USAGE last = cap.IsRange ? cap.Range.UsageMax : cap.NotRange.Usage;
+                    for (uint32_t u = first; u <= last && u - first < HidEvent::kMaxCountOfButtonsPerPage; u++)
+                        buttons.push_back({UsageIndex::Key(cap.UsagePage, static_cast<uint16_t>(u)), static_cast<uint16_t>(i), static_cast<uint16_t>(u - first)});
+                }
+                caps->ButtonIndex.Build(buttons);
+
+                int slider_count = 0;
+                int hat_switch_count = 0;
+                caps->JoystickLayout.reserve(caps->ValueCaps.size());
+                for (const HIDP_VALUE_CAPS& cap : caps->ValueCaps)
+                {
+                    const auto role = JoystickValueRole::Classify(cap.UsagePage, cap.NotRange.Usage, slider_count, hat_switch_count);
+                    caps->JoystickLayout.push_back(JoystickAxisLayout::FromValueCap(cap, role));
+                }
+
+                if (caps->HidPCaps.UsagePage == HID_USAGE_PAGE_DIGITIZER)
+                {
+                    caps->Digitizer = DigitizerLayout::FromValueCaps(caps->ValueCaps);
+                }
+
+                caps->Imu = ImuLayout::FromValueCaps(caps->ValueCaps);
+                caps->Wheel = WheelLayout::FromCaps(caps->ValueCaps, caps->ButtonCaps, caps->PreparsedData());
+
+                if (caps->HidPCaps.UsagePage == HID_USAGE_PAGE_GENERIC && caps->HidPCaps.Usage == HID_USAGE_GENERIC_MULTI_AXIS_CONTROLLER)
+                {
+                    caps->MultiAxis = MultiAxisLayout::FromCaps(caps->ValueCaps, caps->ButtonCaps);
+                }
+
+                if (caps->HidPCaps.UsagePage == HID_USAGE_PAGE_CONSUMER)
+                {
+                    caps->ConsumerControl = ConsumerControlLayout::FromCaps(caps->ValueCaps, caps->PreparsedData());
+                }
             }
             else
             {
@@ -502,20 +3174,25 @@ namespace ttsuki::librawinput
         return caps;
     }
 
-    HidEvent HidEvent::Parse(const RAWINPUT* input, TIMESTAMP timestamp, const HidDeviceCaps* caps)
+    template <size_t TMaxCountOfValues, size_t TMaxCountOfButtonPages>
+    BasicHidEvent<TMaxCountOfValues, TMaxCountOfButtonPages> BasicHidEvent<TMaxCountOfValues, TMaxCountOfButtonPages>::Parse(const RAWINPUT* input, TIMESTAMP timestamp, const HidDeviceCaps* caps)
     {
-        HidEvent e{};
+        BasicHidEvent e{};
         e.Device = input->header.hDevice;
         e.Timestamp = timestamp;
         e.Caps = caps;
+        e.ValueSlots.fill(kNoSlot);
+        e.ButtonSlots.fill(kNoSlot);
 
         if (caps)
         {
             const auto input_data = reinterpret_cast<PCHAR>(const_cast<RAWINPUT*>(input)->data.hid.bRawData);
             const auto input_size = input->data.hid.dwSizeHid;
 
+            e.Truncated = caps->ValueCaps.size() > kMaxCountOfValues || caps->ButtonCaps.size() > kMaxCountOfButtonPages;
+
             // process value input
-            const size_t value_count = std::min(caps->ValueCaps.size(), e.Values.capacity());
+            const size_t value_count = std::min(caps->ValueCaps.size(), kMaxCountOfValues);
             for (size_t i = 0; i < value_count; i++)
             {
                 const HIDP_VALUE_CAPS& cap = caps->ValueCaps[i];
@@ -525,6 +3202,8 @@ namespace ttsuki::librawinput
                     cap.UsagePage, 0, cap.NotRange.Usage, &value,
                     caps->PreparsedData(), input_data, input_size) == HIDP_STATUS_SUCCESS)
                 {
+                    e.ValueCapIndices[e.Values.size()] = static_cast<uint8_t>(i);
+                    e.ValueSlots[i] = static_cast<uint8_t>(e.Values.size());
                     e.Values.push_back({
                         static_cast<uint16_t>(cap.UsagePage),
                         static_cast<uint16_t>(cap.NotRange.Usage),
@@ -536,7 +3215,7 @@ namespace ttsuki::librawinput
             }
 
             // process button input
-            const size_t button_page_count = std::min(caps->ButtonCaps.size(), e.Buttons.capacity());
+            const size_t button_page_count = std::min(caps->ButtonCaps.size(), kMaxCountOfButtonPages);
             for (size_t i = 0; i < button_page_count; i++)
             {
                 const HIDP_BUTTON_CAPS& cap = caps->ButtonCaps[i];
@@ -563,6 +3242,7 @@ namespace ttsuki::librawinput
                         }
                     }
 
+                    e.ButtonSlots[i] = static_cast<uint8_t>(e.Buttons.size());
                     e.Buttons.push_back({
                         static_cast<uint16_t>(cap.UsagePage),
                         static_cast<uint16_t>(first),
@@ -577,11 +3257,47 @@ namespace ttsuki::librawinput
         return e;
     }
 
-    JoystickHidEvent JoystickHidEvent::FromHidEvent(const HidEvent& e)
+    HidUsageHandle ResolveHidValueUsage(const HidDeviceCaps* caps, uint16_t page, uint16_t usage)
+    {
+        return caps ? caps->ValueIndex.Find(page, usage) : HidUsageHandle{};
+    }
+
+    HidUsageHandle ResolveHidButtonUsage(const HidDeviceCaps* caps, uint16_t page, uint16_t usage)
+    {
+        return caps ? caps->ButtonIndex.Find(page, usage) : HidUsageHandle{};
+    }
+
+    template HidEvent HidEvent::Parse(const RAWINPUT* input, TIMESTAMP timestamp, const HidDeviceCaps* caps);
+    template SmallHidEvent SmallHidEvent::Parse(const RAWINPUT* input, TIMESTAMP timestamp, const HidDeviceCaps* caps);
+    template LargeHidEvent LargeHidEvent::Parse(const RAWINPUT* input, TIMESTAMP timestamp, const HidDeviceCaps* caps);
+
+    /// Packs buttons of the button page into a bitset.
+    /// @returns button count
+    template <size_t TMaxCountOfButtonPages>
+    static uint32_t PackJoystickButtons(const ARRAY<HidButtonInput, TMaxCountOfButtonPages>& buttons, std::bitset<64>& bits)
+    {
+        uint32_t button_index = 0;
+        uint64_t button_status = 0;
+        for (auto&& p : buttons)
+        {
+            if (p.Page == HID_USAGE_PAGE_BUTTON)
+            {
+                button_status |= p.ButtonStatuses << button_index;
+                button_index += p.ButtonCount;
+            }
+
+            if (button_index >= bits.size()) break;
+        }
+        bits |= std::bitset<64>(button_status);
+        return button_index;
+    }
+
+    template <size_t TMaxCountOfValues, size_t TMaxCountOfButtonPages>
+    JoystickHidEvent JoystickHidEvent::FromHidEvent(const BasicHidEvent<TMaxCountOfValues, TMaxCountOfButtonPages>& e)
     {
         JoystickHidEvent r{e.Device, e.Timestamp};
 
-        const auto normalize_axis = [](const HidEvent::ValueInput& v)-> float
+        const auto normalize_axis = [](const HidValueInput& v)-> float
         {
             const float val = static_cast<float>(v.Value);
             const float min = static_cast<float>(v.MinValue);
@@ -590,7 +3306,7 @@ namespace ttsuki::librawinput
             return std::clamp((val - center) / center, -1.0f, 1.0f);
         };
 
-        const auto normalize_throttle = [](const HidEvent::ValueInput& v)-> std::optional<float>
+        const auto normalize_throttle = [](const HidValueInput& v)-> std::optional<float>
         {
             const float val = static_cast<float>(v.Value);
             const float min = static_cast<float>(v.MinValue);
@@ -605,132 +3321,134 @@ namespace ttsuki::librawinput
             return std::nullopt;
         };
 
+        const auto set_axis = [&r](JoystickAxis a, std::optional<float> v)
+        {
+            if (v)
+            {
+                r.SetAxis(a, *v);
+            }
+            else
+            {
+                r.Axes[static_cast<size_t>(a)] = 0.0f;
+                r.AxisPresence &= ~(1u << static_cast<uint32_t>(a));
+            }
+        };
+
+        const float PI2 = std::acos(-1.0f) * 2.0f;
+        const auto set_hat_switch = [&r, &set_axis, PI2](uint32_t index, std::optional<float> v)
+        {
+            const auto hat = static_cast<JoystickAxis>(static_cast<uint32_t>(JoystickAxis::HatSwitch0) + index);
+            const auto hat_x = static_cast<JoystickAxis>(static_cast<uint32_t>(JoystickAxis::HatSwitch0X) + index * 2);
+            const auto hat_y = static_cast<JoystickAxis>(static_cast<uint32_t>(JoystickAxis::HatSwitch0Y) + index * 2);
+            set_axis(hat, v);
+            r.SetAxis(hat_x, v ? std::cos(*v * PI2) : 0.0f);
+            r.SetAxis(hat_y, v ? std::sin(*v * PI2) : 0.0f);
+        };
+
         int slider_count = 0;
         int hat_switch_count = 0;
-        const float PI2 = std::acos(-1.0f) * 2.0f;
 
         for (auto&& value : e.Values)
         {
-            if (value.Page == HID_USAGE_PAGE_GENERIC)
+            const auto role = JoystickValueRole::Classify(value.Page, value.Usage, slider_count, hat_switch_count);
+            switch (role.Kind)
             {
-                switch (value.Usage)
-                {
-                case HID_USAGE_GENERIC_X:
-                    r.X = normalize_axis(value);
-                    break;
-                case HID_USAGE_GENERIC_Y:
-                    r.Y = normalize_axis(value);
-                    break;
-                case HID_USAGE_GENERIC_Z:
-                    r.Z = normalize_axis(value);
-                    break;
-                case HID_USAGE_GENERIC_RX:
-                    r.RotX = normalize_axis(value);
-                    break;
-                case HID_USAGE_GENERIC_RY:
-                    r.RotY = normalize_axis(value);
-                    break;
-                case HID_USAGE_GENERIC_RZ:
-                    r.RotZ = normalize_axis(value);
-                    break;
+            case JoystickValueRole::RoleKind::Axis:
+                r.SetAxis(static_cast<JoystickAxis>(role.Index), normalize_axis(value));
+                break;
+            case JoystickValueRole::RoleKind::Throttle:
+                set_axis(static_cast<JoystickAxis>(role.Index), normalize_throttle(value));
+                break;
+            case JoystickValueRole::RoleKind::HatSwitch:
+                set_hat_switch(role.Index, normalize_throttle(value));
+                break;
+            default: // ignore value
+                break;
+            }
+        }
 
-                case HID_USAGE_GENERIC_SLIDER:
-                    switch (slider_count++)
-                    {
-                    case 0:
-                        r.Slider0 = normalize_throttle(value);
-                        break;
-                    case 1:
-                        r.Slider1 = normalize_throttle(value);
-                        break;
-                    case 2:
-                        r.Slider2 = normalize_throttle(value);
-                        break;
-                    case 3:
-                        r.Slider3 = normalize_throttle(value);
-                        break;
-                    default: // ignore
-                        break;
-                    }
-                    break;
+        r.ButtonCount = PackJoystickButtons(e.Buttons, r.Buttons);
+        return r;
+    }
 
-                case HID_USAGE_GENERIC_HATSWITCH:
-                    switch (hat_switch_count++)
-                    {
-                    case 0:
-                        r.HatSwitch0 = normalize_throttle(value);
-                        r.HatSwitch0X = r.HatSwitch0 ? std::cos(*r.HatSwitch0 * PI2) : 0.0f;
-                        r.HatSwitch0Y = r.HatSwitch0 ? std::sin(*r.HatSwitch0 * PI2) : 0.0f;
-                        break;
-                    case 1:
-                        r.HatSwitch1 = normalize_throttle(value);
-                        r.HatSwitch1X = r.HatSwitch1 ? std::cos(*r.HatSwitch1 * PI2) : 0.0f;
-                        r.HatSwitch1Y = r.HatSwitch1 ? std::sin(*r.HatSwitch1 * PI2) : 0.0f;
-                        break;
-                    default: // ignore
-                        break;
-                    }
-                    break;
+    template JoystickHidEvent JoystickHidEvent::FromHidEvent(const HidEvent& e);
+    template JoystickHidEvent JoystickHidEvent::FromHidEvent(const SmallHidEvent& e);
+    template JoystickHidEvent JoystickHidEvent::FromHidEvent(const LargeHidEvent& e);
 
-                default: // ignore value
-                    break;
-                }
-            }
+    template <size_t TMaxCountOfValues, size_t TMaxCountOfButtonPages>
+    FixedJoystickHidEvent FixedJoystickHidEvent::FromHidEvent(const BasicHidEvent<TMaxCountOfValues, TMaxCountOfButtonPages>& e)
+    {
+        FixedJoystickHidEvent r{e.Device, e.Timestamp};
 
-            if (value.Page == HID_USAGE_PAGE_SIMULATION)
+        const auto clear_axis = [&r](JoystickAxis a)
+        {
+            r.Axes[static_cast<size_t>(a)] = 0;
+            r.AxisPresence &= ~(1u << static_cast<uint32_t>(a));
+        };
+
+        if (e.Caps)
+        {
+            const std::vector<JoystickAxisLayout>& layout = e.Caps->JoystickLayout;
+            for (size_t i = 0; i < e.Values.size(); i++)
             {
-                switch (value.Usage)
+                const JoystickAxisLayout& l = layout[e.ValueCapIndices[i]];
+                const int64_t value = e.Values[i].Value;
+
+                switch (l.Role.Kind)
                 {
-                case HID_USAGE_SIMULATION_STEERING:
-                    r.X = normalize_axis(value);
-                    break;
-                case HID_USAGE_SIMULATION_ACCELLERATOR:
-                    r.Y = normalize_axis(value);
-                    break;
-                case HID_USAGE_SIMULATION_BRAKE:
-                    r.Z = normalize_axis(value);
-                    break;
-                case HID_USAGE_SIMULATION_RUDDER:
-                    r.RotZ = normalize_axis(value);
-                    break;
-                case HID_USAGE_SIMULATION_THROTTLE:
-                    r.Slider0 = normalize_throttle(value);
-                    break;
-                default:
+                case JoystickValueRole::RoleKind::Axis:
+                {
+                    // same as the float conversion: (value - range / 2) / (range / 2), in doubled units.
+                    const int64_t x2 = std::clamp(value * 2 - l.Range, -l.Range, l.Range);
+                    const int64_t out = std::clamp<int64_t>((x2 * l.Scale + 0x8000) >> 16, -kSignedOne, kSignedOne);
+                    r.SetAxis(static_cast<JoystickAxis>(l.Role.Index), static_cast<uint16_t>(static_cast<int16_t>(out)));
                     break;
                 }
-            }
 
-            if (value.Page == HID_USAGE_PAGE_GAME)
-            {
-                switch (value.Usage)
+                case JoystickValueRole::RoleKind::Throttle:
                 {
-                case HID_USAGE_GAME_POINT_OF_VIEW:
-                    r.HatSwitch0 = normalize_throttle(value);
-                    r.HatSwitch0X = r.HatSwitch0 ? std::cos(*r.HatSwitch0 * PI2) : 0.0f;
-                    r.HatSwitch0Y = r.HatSwitch0 ? std::sin(*r.HatSwitch0 * PI2) : 0.0f;
+                    const auto axis = static_cast<JoystickAxis>(l.Role.Index);
+                    const int64_t x = value - l.Min;
+                    if (l.Range > 0 && 0 <= x && x <= l.Range)
+                        r.SetAxis(axis, static_cast<uint16_t>(std::min<int64_t>((x * l.Scale + 0x8000) >> 16, kUnsignedOne)));
+                    else
+                        clear_axis(axis);
                     break;
-                default:
+                }
+
+                case JoystickValueRole::RoleKind::HatSwitch:
+                {
+                    const auto hat = static_cast<JoystickAxis>(static_cast<uint32_t>(JoystickAxis::HatSwitch0) + l.Role.Index);
+                    const auto hat_x = static_cast<JoystickAxis>(static_cast<uint32_t>(JoystickAxis::HatSwitch0X) + l.Role.Index * 2);
+                    const auto hat_y = static_cast<JoystickAxis>(static_cast<uint32_t>(JoystickAxis::HatSwitch0Y) + l.Role.Index * 2);
+                    const int64_t x = value - l.Min;
+                    if (l.Range > 0 && 0 <= x && x <= l.Range)
+                    {
+                        const auto& xy = l.HatSwitchXY[static_cast<size_t>((x * l.HatSwitchIndexScale + 0x8000) >> 16)];
+                        r.SetAxis(hat, static_cast<uint16_t>(std::min<int64_t>((x * l.Scale + 0x8000) >> 16, kUnsignedOne)));
+                        r.SetAxis(hat_x, static_cast<uint16_t>(xy[0]));
+                        r.SetAxis(hat_y, static_cast<uint16_t>(xy[1]));
+                    }
+                    else
+                    {
+                        clear_axis(hat);
+                        r.SetAxis(hat_x, 0);
+                        r.SetAxis(hat_y, 0);
+                    }
                     break;
                 }
-            }
-        }
 
-        uint32_t button_index = 0;
-        uint64_t button_status = 0;
-        for (auto&& p : e.Buttons)
-        {
-            if (p.Page == HID_USAGE_PAGE_BUTTON)
-            {
-                button_status |= p.ButtonStatuses << button_index;
-                button_index += p.ButtonCount;
+                default: // ignore value
+                    break;
+                }
             }
-
-            if (button_index >= r.Buttons.size()) break;
         }
-        r.ButtonCount = button_index;
-        r.Buttons |= std::bitset<64>(button_status);
 
+        r.ButtonCount = PackJoystickButtons(e.Buttons, r.Buttons);
         return r;
     }
+
+    template FixedJoystickHidEvent FixedJoystickHidEvent::FromHidEvent(const HidEvent& e);
+    template FixedJoystickHidEvent FixedJoystickHidEvent::FromHidEvent(const SmallHidEvent& e);
+    template FixedJoystickHidEvent FixedJoystickHidEvent::FromHidEvent(const LargeHidEvent& e);
 }
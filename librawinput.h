@@ -18,11 +18,13 @@
 #include <memory>
 #include <chrono>
 #include <string>
+#include <string_view>
 #include <array>
 #include <vector>
 #include <optional>
 #include <bitset>
 #include <functional>
+#include <future>
 
 namespace ttsuki::librawinput
 {
@@ -52,6 +54,7 @@ namespace ttsuki::librawinput
         [[nodiscard]] size_t capacity() const { return TCapacity; }
         [[nodiscard]] bool empty() const { return size() == 0; }
         [[nodiscard]] const T& operator [](size_t i) const { return values[i]; }
+        [[nodiscard]] const T& back() const { return values[count - 1]; }
         [[nodiscard]] auto begin() const { return values.begin(); }
         [[nodiscard]] auto end() const { return values.begin() + count; }
         void clear() { count = 0; }
@@ -68,6 +71,9 @@ namespace ttsuki::librawinput
         Keyboard = 0x02,
         Joystick = 0x04,
         GamePad = 0x08,
+        Digitizer = 0x10, // touch pad, touch screen and pen
+        ConsumerControl = 0x20, // media keys, volume knobs
+        MultiAxis = 0x40, // 6-DOF multi-axis controller (e.g. 3D mouse)
         Other = 0x80000000,
         ALL = ~0u,
     };
@@ -76,6 +82,9 @@ namespace ttsuki::librawinput
     {
         HANDLE Handle{};
         RawInputDeviceType Type{};
+        uint16_t VendorId{};
+        uint16_t ProductId{};
+        uint16_t VersionNumber{};
         std::wstring Path{};
         std::wstring ManufactureName{};
         std::wstring ProductName{};
@@ -89,14 +98,96 @@ namespace ttsuki::librawinput
 
     struct KeyboardEvent;
     struct MouseEvent;
-    struct HidEvent;
+    template <size_t TMaxCountOfValues, size_t TMaxCountOfButtonPages>
+    struct BasicHidEvent;
     struct JoystickHidEvent;
+    struct FixedJoystickHidEvent;
+    struct TouchEvent;
+    struct PenEvent;
+    struct ConsumerControlEvent;
+    struct ImuEvent;
+    struct MultiAxisEvent;
+    struct WheelEvent;
+    struct StandardGamepadEvent;
+    struct MouseGestureEvent;
+    struct MouseStrokeEvent;
+    struct BarcodeEvent;
+
+    /// HidEvent with the default capacity.
+    using HidEvent = BasicHidEvent<16, 16>;
+
+    /// HidEvent for simple devices (e.g. pads with a few axes).
+    using SmallHidEvent = BasicHidEvent<4, 2>;
+
+    /// HidEvent for devices with many axes (e.g. flight sim HOTAS).
+    using LargeHidEvent = BasicHidEvent<64, 16>;
 
     using RawInputEventCallback = std::function<void(const RAWINPUT* input, TIMESTAMP timestamp)>;
     using KeyboardEventCallback = std::function<void(const KeyboardEvent&)>;
     using MouseEventCallback = std::function<void(const MouseEvent&)>;
     using HidEventCallback = std::function<void(const HidEvent&)>;
+    using SmallHidEventCallback = std::function<void(const SmallHidEvent&)>;
+    using LargeHidEventCallback = std::function<void(const LargeHidEvent&)>;
     using JoystickHidEventCallback = std::function<void(const JoystickHidEvent&)>;
+    using FixedJoystickHidEventCallback = std::function<void(const FixedJoystickHidEvent&)>;
+    using TouchEventCallback = std::function<void(const TouchEvent&)>;
+    using PenEventCallback = std::function<void(const PenEvent&)>;
+    using PenEventBatchCallback = std::function<void(const PenEvent* events, size_t count)>;
+    using ConsumerControlEventCallback = std::function<void(const ConsumerControlEvent&)>;
+    using ImuEventCallback = std::function<void(const ImuEvent&)>;
+    using MultiAxisEventCallback = std::function<void(const MultiAxisEvent&)>;
+    using WheelEventCallback = std::function<void(const WheelEvent&)>;
+    using StandardGamepadEventCallback = std::function<void(const StandardGamepadEvent&)>;
+    using MouseGestureEventCallback = std::function<void(const MouseGestureEvent&)>;
+    using MouseStrokeEventCallback = std::function<void(const MouseStrokeEvent&)>;
+    using BarcodeEventCallback = std::function<void(const BarcodeEvent&)>;
+    using ListenerReadyCallback = std::function<void()>;
+    using DeviceIdleStateCallback = std::function<void(HANDLE device, bool idle, TIMESTAMP timestamp)>;
+
+    /// Consumer callbacks watched by the callback watchdog.
+    enum struct RawInputCallbackKind : uint32_t
+    {
+        RawInput,
+        Keyboard,
+        Mouse,
+        Hid,
+        SmallHid,
+        LargeHid,
+        JoystickHid,
+        FixedJoystickHid,
+        Touch,
+        Pen,
+        PenBatch,
+        ConsumerControl,
+        Imu,
+        MultiAxis,
+        Wheel,
+        StandardGamepad,
+        MouseGesture,
+        MouseStroke,
+        Barcode,
+        ListenerReady,
+        DeviceIdleState,
+    };
+
+    static inline constexpr size_t kRawInputCallbackKindCount = 21;
+
+    struct CallbackOverrun
+    {
+        RawInputCallbackKind Callback{};
+        TIMESTAMP StartTime{};
+
+        /// Time (in microseconds) the callback has taken.
+        TIMESTAMP Duration{};
+
+        /// false: detected by the watchdog while the callback is still running.
+        bool Finished{};
+
+        /// true: the consumer has been switched to queued delivery.
+        bool SwitchedToQueued{};
+    };
+
+    using CallbackOverrunCallback = std::function<void(const CallbackOverrun&)>;
 
     struct RawInputCallbacks
     {
@@ -104,7 +195,209 @@ namespace ttsuki::librawinput
         KeyboardEventCallback KeyboardEventCallback{};
         MouseEventCallback MouseEventCallback{};
         HidEventCallback HidEventCallback{};
+        SmallHidEventCallback SmallHidEventCallback{};
+        LargeHidEventCallback LargeHidEventCallback{};
         JoystickHidEventCallback JoystickHidEventCallback{};
+
+        /// Joystick events in 16-bit fixed point, normalized without floating point arithmetic.
+        FixedJoystickHidEventCallback FixedJoystickHidEventCallback{};
+
+        /// Touch frames of touch pads and touch screens. Requires RawInputDeviceType::Digitizer.
+        TouchEventCallback TouchEventCallback{};
+
+        /// Pen samples, one by one. Requires RawInputDeviceType::Digitizer.
+        PenEventCallback PenEventCallback{};
+
+        /// Pen samples in batches. A batch holds consecutive samples of one device with the same tip state
+        /// (a stroke, or hovering), and is delivered when the stroke ends, the batch is full, or no more raw input is queued.
+        PenEventBatchCallback PenEventBatchCallback{};
+
+        /// Consumer control reports (usage page 0x0C). Requires RawInputDeviceType::ConsumerControl.
+        ConsumerControlEventCallback ConsumerControlEventCallback{};
+
+        /// Accelerometer and gyrometer samples of devices exposing them on the sensor page (0x20).
+        /// Motion in vendor-defined reports (e.g. DualShock 4 and DualSense) is not decoded: such gamepads produce no ImuEvent.
+        ImuEventCallback ImuEventCallback{};
+
+        /// 6-DOF frames of multi-axis controllers. Requires RawInputDeviceType::MultiAxis (or Other).
+        MultiAxisEventCallback MultiAxisEventCallback{};
+
+        /// Racing wheels and pedals (simulation page steering, accelerator, brake and clutch).
+        WheelEventCallback WheelEventCallback{};
+
+        /// Gamepads in the standard layout. Built-in mappings cover common Xbox, PlayStation and Logitech pads,
+        /// other Gamepad-usage devices use a generic layout. More can be loaded by LoadRawInputGamepadMappings.
+        StandardGamepadEventCallback StandardGamepadEventCallback{};
+
+        /// Clicks, double-clicks and drags of mouse buttons (see RawInputListenerOptions::MouseGesture).
+        MouseGestureEventCallback MouseGestureEventCallback{};
+
+        /// Flicks, straight strokes, circles and template shapes drawn by mouse motion (see RawInputListenerOptions::MouseStroke).
+        MouseStrokeEventCallback MouseStrokeEventCallback{};
+
+        /// Keystroke bursts of barcode scanners acting as keyboards (see RawInputListenerOptions::BarcodeScanner).
+        /// Keys of the bursts are removed from KeyboardEvent and the key-state bitmap.
+        BarcodeEventCallback BarcodeEventCallback{};
+
+        /// Called on the capture thread when the listener has registered devices and built device caps.
+        ListenerReadyCallback ListenerReadyCallback{};
+
+        /// Called on the capture thread when a device becomes idle or active. Requires RawInputListenerOptions::DeviceIdleTimeout.
+        DeviceIdleStateCallback DeviceIdleStateCallback{};
+
+        /// Called when a consumer callback exceeds RawInputListenerOptions::CallbackBudget.
+        /// Called on the watchdog thread while the callback is still running, and on the capture thread after it has finished.
+        CallbackOverrunCallback CallbackOverrunCallback{};
+    };
+
+    /// Capture thread settings, applied by the capture thread itself on start.
+    struct RawInputThreadOptions
+    {
+        /// Processor affinity mask. 0: not changed.
+        uint64_t AffinityMask{};
+
+        /// Thread priority (THREAD_PRIORITY_*).
+        int Priority{THREAD_PRIORITY_HIGHEST};
+
+        /// MMCSS task name (e.g. L"Games", L"Pro Audio"). Empty: MMCSS is not used.
+        std::wstring MmcssTaskName{};
+
+        /// MMCSS priority (AVRT_PRIORITY_*). Used only with MmcssTaskName.
+        int MmcssPriority{};
+
+        /// Thread description shown in debuggers and profilers. Empty: not changed.
+        std::wstring Name{L"librawinput"};
+
+        /// Polls the message queue with spin-wait instead of blocking in GetMessage.
+        /// Trades a processor core for lower wake-up latency.
+        bool BusyPoll{};
+
+        /// Busy poll: time (in microseconds) to spin after the last message before yielding.
+        TIMESTAMP BusyPollSpinTime{2000};
+
+        /// Busy poll: time (in microseconds) to yield after spinning before backing off to blocking wait.
+        TIMESTAMP BusyPollYieldTime{8000};
+    };
+
+    enum struct ImuOrientationFilter : uint32_t
+    {
+        None,
+        Madgwick,
+    };
+
+    /// Thresholds of click, double-click and drag detection.
+    struct MouseGestureOptions
+    {
+        /// Max time (in microseconds) from a click to the next press to be a double-click.
+        TIMESTAMP DoubleClickTime{500000};
+
+        /// Max distance (in device units, e.g. mickeys) from a click to the next press to be a double-click.
+        int32_t DoubleClickDistance{4};
+
+        /// Distance (in device units) a pressed button has to move to start a drag.
+        int32_t DragDistance{4};
+    };
+
+    /// Shape to be recognized as MouseStrokeKind::Template.
+    struct MouseStrokeTemplate
+    {
+        /// Reported in MouseStrokeEvent::TemplateId.
+        uint32_t Id{};
+
+        /// Polyline of the shape, +Y down. Size and position do not matter; the direction of drawing does.
+        std::vector<std::array<float, 2>> Points{};
+    };
+
+    /// Settings of stroke recognition.
+    struct MouseStrokeOptions
+    {
+        /// Button (RI_MOUSE_*_BUTTON_DOWN) to be held while drawing a stroke.
+        /// 0: any motion makes a stroke, ended by a pause of StrokeGapTime.
+        uint32_t TriggerButton{RI_MOUSE_RIGHT_BUTTON_DOWN};
+
+        /// Pause (in microseconds) ending a stroke without trigger button.
+        TIMESTAMP StrokeGapTime{100000};
+
+        /// Strokes shorter than this (in device units, e.g. mickeys) are ignored.
+        float MinStrokeLength{40.0f};
+
+        /// Max duration (in microseconds) and min speed (in device units per second) of a flick.
+        TIMESTAMP FlickMaxTime{150000};
+        float FlickMinSpeed{2000.0f};
+
+        /// Min score (0.0 to 1.0) of a template match.
+        float MinTemplateScore{0.85f};
+
+        std::vector<MouseStrokeTemplate> Templates{};
+    };
+
+    /// Settings of barcode scanner burst detection.
+    struct BarcodeScannerOptions
+    {
+        /// Max time (in microseconds) between key presses of a burst.
+        TIMESTAMP MaxInterKeyTime{20000};
+
+        /// Min count of key presses of a burst.
+        uint32_t MinBurstLength{6};
+
+        /// Regards a keyboard which has sent a burst as a scanner, from its next burst.
+        /// Otherwise only devices set by SetRawInputBarcodeScanner are scanners.
+        bool AutoDetect{true};
+    };
+
+    /// Settings of a per-mouse cursor.
+    struct RawInputCursorOptions
+    {
+        /// Rectangle the cursor is clamped in. Absolute mice are mapped onto it.
+        float Left{};
+        float Top{};
+        float Right{1920.0f};
+        float Bottom{1080.0f};
+
+        /// Cursor distance per device unit (e.g. mickey).
+        float Sensitivity{1.0f};
+
+        /// Gain added per speed (in device units per millisecond): gain = Sensitivity * (1 + Acceleration * speed).
+        float Acceleration{};
+
+        /// Upper limit of the gain. 0: not limited.
+        float MaxGain{};
+    };
+
+    struct RawInputListenerOptions
+    {
+        RawInputThreadOptions CaptureThread{};
+
+        /// Time (in microseconds) without input after which a device is regarded as idle. 0: idle detection is disabled.
+        TIMESTAMP DeviceIdleTimeout{};
+
+        /// Time budget (in microseconds) of each consumer callback call. 0: callbacks are not timed and not watched.
+        TIMESTAMP CallbackBudget{};
+
+        /// Moves a consumer which has exceeded CallbackBudget to queued delivery on its own thread,
+        /// so that it no longer stalls input capture.
+        bool QueueOverrunningCallbacks{};
+
+        /// Orientation fusion of IMU samples. None: ImuEvent::Orientation is not computed.
+        ImuOrientationFilter ImuOrientationFilter{};
+
+        /// Gain (beta) of the Madgwick filter. Larger values correct gyro drift faster but are noisier.
+        float ImuFilterGain{0.1f};
+
+        /// Sensitivity multiplied to each multi-axis controller axis: translation X, Y, Z, then rotation X, Y, Z.
+        std::array<float, 6> MultiAxisSensitivity{1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+
+        /// Thresholds of MouseGestureEvent.
+        MouseGestureOptions MouseGesture{};
+
+        /// Settings of MouseStrokeEvent.
+        MouseStrokeOptions MouseStroke{};
+
+        /// Default settings of cursors (see UpdateRawInputCursors).
+        RawInputCursorOptions Cursor{};
+
+        /// Settings of BarcodeEvent.
+        BarcodeScannerOptions BarcodeScanner{};
     };
 
     /// Starts listening raw input events.
@@ -113,6 +406,240 @@ namespace ttsuki::librawinput
     /// @returns listener handle
     std::shared_ptr<void> StartRawInput(RawInputDeviceType target_device_types, RawInputCallbacks callbacks);
 
+    /// Starts listening raw input events.
+    /// @param target_device_types target devices (bitwise or-ed)
+    /// @param callbacks event callbacks
+    /// @param options listener options
+    /// @returns listener handle
+    std::shared_ptr<void> StartRawInput(RawInputDeviceType target_device_types, RawInputCallbacks callbacks, RawInputListenerOptions options);
+
+    struct RawInputAsyncStart
+    {
+        /// Listener handle
+        std::shared_ptr<void> Listener{};
+
+        /// Becomes ready when the listener has registered devices and built device caps.
+        std::shared_future<void> Ready{};
+    };
+
+    /// Starts listening raw input events without waiting for the capture thread.
+    /// Device registration, device enumeration and caps building run on the capture thread.
+    /// Events from devices not enumerated yet are handled: their caps are built on first event.
+    /// @param target_device_types target devices (bitwise or-ed)
+    /// @param callbacks event callbacks
+    /// @param options listener options
+    /// @returns listener handle and its ready future
+    RawInputAsyncStart StartRawInputAsync(RawInputDeviceType target_device_types, RawInputCallbacks callbacks, RawInputListenerOptions options = {});
+
+    /// Consumer callback timing. Collected only with RawInputListenerOptions::CallbackBudget.
+    struct RawInputCallbackStatistics
+    {
+        uint64_t CallCount{};
+        TIMESTAMP TotalTime{};
+        TIMESTAMP MaxTime{};
+        uint64_t OverrunCount{};
+        bool Queued{};
+    };
+
+    /// Capture thread statistics.
+    struct RawInputListenerStatistics
+    {
+        /// Count of processed WM_INPUT messages.
+        uint64_t InputCount{};
+
+        /// Busy poll: count of spin rounds which found no message.
+        uint64_t SpinCount{};
+
+        /// Busy poll: count of yields which found no message.
+        uint64_t YieldCount{};
+
+        /// Busy poll: count of blocking waits after spinning and yielding.
+        uint64_t BlockingWaitCount{};
+
+        /// CPU time (user + kernel) consumed by the capture thread, in microseconds.
+        TIMESTAMP CpuTime{};
+
+        /// Elapsed time since the capture thread started, in microseconds.
+        TIMESTAMP WallTime{};
+
+        /// Wake-up latency measured by ProbeRawInputWakeUpLatency, in microseconds.
+        uint64_t WakeUpLatencySampleCount{};
+        TIMESTAMP WakeUpLatencyMin{};
+        TIMESTAMP WakeUpLatencyMax{};
+        double WakeUpLatencyAverage{};
+
+        /// Consumer callback timing, indexed by RawInputCallbackKind.
+        std::array<RawInputCallbackStatistics, kRawInputCallbackKindCount> Callbacks{};
+    };
+
+    /// Gets capture thread statistics.
+    /// @param listener listener handle returned by StartRawInput
+    RawInputListenerStatistics GetRawInputListenerStatistics(const std::shared_ptr<void>& listener);
+
+    /// Posts a wake-up latency probe to the capture thread.
+    /// The time from posting to the probe being dispatched is recorded into the listener statistics.
+    /// @param listener listener handle returned by StartRawInput
+    void ProbeRawInputWakeUpLatency(const std::shared_ptr<void>& listener);
+
+    /// Waits until the listener processes any input, or timeout.
+    /// The calling thread sleeps in the kernel; the capture thread signals it only while someone is waiting.
+    /// @param listener listener handle returned by StartRawInput
+    /// @param last_sequence input sequence number returned by the previous call (0 at first). Returns immediately if newer input has been processed.
+    /// @param timeout timeout in microseconds (rounded up to milliseconds). Negative: infinite.
+    /// @returns input sequence number. Equals to last_sequence on timeout.
+    uint64_t WaitForRawInput(const std::shared_ptr<void>& listener, uint64_t last_sequence, TIMESTAMP timeout);
+
+    struct RawInputDeviceActivity
+    {
+        HANDLE Device{};
+        TIMESTAMP LastInputTime{};
+        bool Idle{};
+    };
+
+    /// Gets activity of devices which have sent input. Requires RawInputListenerOptions::DeviceIdleTimeout.
+    /// @param listener listener handle returned by StartRawInput
+    std::vector<RawInputDeviceActivity> GetRawInputDeviceActivity(const std::shared_ptr<void>& listener);
+
+    /// Loads gamepad mappings in the SDL game controller database format (gamecontrollerdb.txt).
+    /// Mappings for platforms other than Windows are skipped. A mapping replaces the loaded (or built-in) one with the same GUID.
+    /// Sources bN, aN and hN.M refer the N-th button usage, the N-th non-hat value usage (ordered by page and usage)
+    /// and the N-th hat switch of the device.
+    /// @param listener listener handle returned by StartRawInput
+    /// @param database database text
+    /// @returns count of loaded mappings
+    size_t LoadRawInputGamepadMappings(const std::shared_ptr<void>& listener, std::string_view database);
+
+    /// Merges racing wheel devices (e.g. a wheel and a separate pedal box) into one logical device.
+    /// WheelEvent of any merged device carries channels of all of them, with Device set to devices[0].
+    /// Buttons are concatenated in the order of devices. Merging a device separates it from its previous group.
+    /// @param listener listener handle returned by StartRawInput
+    /// @param devices devices to merge. A single device or none: only separates them.
+    void MergeRawInputWheelDevices(const std::shared_ptr<void>& listener, const std::vector<HANDLE>& devices);
+
+    /// Keeps device caps referred by events (HidEvent::Caps) alive after the device is removed.
+    /// Events delivered in callbacks are valid during the callback.
+    /// To retain events beyond the callback, construct a guard in the callback and keep it as long as the events.
+    /// Removed caps are freed after all guards entered before the removal have been destructed; removal never waits for guards.
+    class RawInputEpochGuard final
+    {
+        std::shared_ptr<void> listener_{};
+        size_t slot_{};
+
+    public:
+        /// @param listener listener handle returned by StartRawInput
+        explicit RawInputEpochGuard(std::shared_ptr<void> listener);
+        ~RawInputEpochGuard();
+
+        RawInputEpochGuard(const RawInputEpochGuard& other) = delete;
+        RawInputEpochGuard(RawInputEpochGuard&& other) noexcept;
+        RawInputEpochGuard& operator=(const RawInputEpochGuard& other) = delete;
+        RawInputEpochGuard& operator=(RawInputEpochGuard&& other) noexcept = delete;
+    };
+
+    /// Physical key: scan set 1 make code (0x01-0x7F), plus 0x80 with the E0 prefix.
+    /// Distinguishes left/right modifiers and numpad/navigation keys. Usable as an index of a 256-bit key-state bitmap.
+    enum struct KeyId : uint8_t
+    {
+        None = 0x00,
+
+        Escape = 0x01,
+        Backspace = 0x0E,
+        Tab = 0x0F,
+        Enter = 0x1C,
+        LeftControl = 0x1D,
+        LeftShift = 0x2A,
+        RightShift = 0x36,
+        NumpadMultiply = 0x37,
+        LeftAlt = 0x38,
+        Space = 0x39,
+        CapsLock = 0x3A,
+        NumLock = 0x45,
+        ScrollLock = 0x46,
+        Numpad7 = 0x47,
+        Numpad8 = 0x48,
+        Numpad9 = 0x49,
+        NumpadSubtract = 0x4A,
+        Numpad4 = 0x4B,
+        Numpad5 = 0x4C,
+        Numpad6 = 0x4D,
+        NumpadAdd = 0x4E,
+        Numpad1 = 0x4F,
+        Numpad2 = 0x50,
+        Numpad3 = 0x51,
+        Numpad0 = 0x52,
+        NumpadDecimal = 0x53,
+        SysRq = 0x54, // Alt+PrintScreen
+
+        NumpadEnter = 0x80 | 0x1C,
+        RightControl = 0x80 | 0x1D,
+        NumpadDivide = 0x80 | 0x35,
+        PrintScreen = 0x80 | 0x37,
+        RightAlt = 0x80 | 0x38,
+        Pause = 0x80 | 0x45, // E1 1D 45
+        Break = 0x80 | 0x46, // Ctrl+Pause
+        Home = 0x80 | 0x47,
+        Up = 0x80 | 0x48,
+        PageUp = 0x80 | 0x49,
+        Left = 0x80 | 0x4B,
+        Right = 0x80 | 0x4D,
+        End = 0x80 | 0x4F,
+        Down = 0x80 | 0x50,
+        PageDown = 0x80 | 0x51,
+        Insert = 0x80 | 0x52,
+        Delete = 0x80 | 0x53,
+        LeftWindows = 0x80 | 0x5B,
+        RightWindows = 0x80 | 0x5C,
+        Application = 0x80 | 0x5D,
+    };
+
+    static constexpr size_t kKeyIdCount = 256;
+
+    /// Gets the physical key of a RAWKEYBOARD.
+    /// @returns KeyId::None for fake keys (VKey 0xFF, e.g. E0 2A sent around navigation keys) and overruns (make code 0xFF).
+    constexpr KeyId ToKeyId(uint16_t make_code, uint16_t flags, uint16_t vkey)
+    {
+        if (vkey == 0xFF || make_code == 0 || make_code > 0x7F) return KeyId::None;
+        if (flags & RI_KEY_E1) return make_code == 0x1D ? KeyId::Pause : KeyId::None;
+        return static_cast<KeyId>(make_code | (flags & RI_KEY_E0 ? 0x80 : 0x00));
+    }
+
+    /// Key rollover statistics of a keyboard.
+    struct RawInputKeyboardStatistics
+    {
+        /// Key-state bitmap indexed by KeyId.
+        std::bitset<kKeyIdCount> PressedKeys{};
+
+        /// Count of keys pressed now.
+        uint32_t PressedKeyCount{};
+
+        /// Max count of simultaneously pressed keys observed.
+        uint32_t MaxRollover{};
+
+        /// Count of key presses, excluding auto-repeats.
+        uint64_t KeyDownCount{};
+
+        /// Count of makes of already pressed keys.
+        uint64_t AutoRepeatCount{};
+
+        /// Count of releases of keys not pressed (dropped makes, or keys held since before the listener started).
+        uint64_t ImpossibleReleaseCount{};
+
+        /// Count of overrun reports (make code 0xFF): the keyboard ran out of rollover and dropped keys.
+        uint64_t OverrunCount{};
+    };
+
+    /// Gets key rollover statistics of a keyboard. Tracked for keyboards while the listener runs.
+    /// @param listener listener handle returned by StartRawInput
+    /// @param device keyboard device handle
+    RawInputKeyboardStatistics GetRawInputKeyboardStatistics(const std::shared_ptr<void>& listener, HANDLE device);
+
+    /// Marks or unmarks a keyboard as a barcode scanner. Requires RawInputCallbacks::BarcodeEventCallback.
+    /// Keys of a scanner are held until its burst ends: bursts make BarcodeEvent, and other keys are delivered late as KeyboardEvent.
+    /// @param listener listener handle returned by StartRawInput
+    /// @param device keyboard device handle
+    /// @param scanner true: the device is a scanner
+    void SetRawInputBarcodeScanner(const std::shared_ptr<void>& listener, HANDLE device, bool scanner);
+
     struct KeyboardEvent
     {
         /// Constructs KeyboardEvent from RAWINPUT.
@@ -125,6 +652,28 @@ namespace ttsuki::librawinput
         [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
         [[nodiscard]] uint16_t VirtualKeyCode() const { return static_cast<uint16_t>(RawKeyboard.VKey); }
         [[nodiscard]] bool KeyIsDown() const { return (RawKeyboard.Flags & RI_KEY_BREAK) == 0; }
+        [[nodiscard]] librawinput::KeyId KeyId() const { return ToKeyId(RawKeyboard.MakeCode, RawKeyboard.Flags, RawKeyboard.VKey); }
+    };
+
+    /// Text typed by a barcode scanner in a burst.
+    struct BarcodeEvent
+    {
+        static constexpr size_t kMaxLength = 256;
+
+        HANDLE Device;
+
+        /// Time of the last key of the burst.
+        TIMESTAMP Timestamp;
+
+        /// Ended by Enter (not included in Text).
+        bool Terminated;
+
+        /// Text in the keyboard layout of the capture thread. Longer text is truncated.
+        uint32_t Length;
+        std::array<wchar_t, kMaxLength> Text;
+
+        [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+        [[nodiscard]] std::wstring_view View() const { return std::wstring_view(Text.data(), Length); }
     };
 
     struct MouseEvent
@@ -136,6 +685,11 @@ namespace ttsuki::librawinput
         TIMESTAMP Timestamp;
         RAWMOUSE RawMouse;
 
+        /// Whole wheel notches completed by this event. Sub-notch (high-resolution) deltas are carried per device.
+        /// Filled by the listener.
+        int32_t WheelNotches;
+        int32_t HorizontalWheelNotches;
+
         enum struct ButtonIndex : uint32_t
         {
             Button1 = RI_MOUSE_LEFT_BUTTON_DOWN,
@@ -156,6 +710,7 @@ namespace ttsuki::librawinput
         [[nodiscard]] int LastY() const { return RawMouse.lLastY; }
         [[nodiscard]] bool LastXYIsAbsolute() const { return RawMouse.usFlags & MOUSE_MOVE_ABSOLUTE; }
         [[nodiscard]] int WheelDelta() const { return (RawMouse.usButtonFlags & RI_MOUSE_WHEEL) ? static_cast<int16_t>(RawMouse.usButtonData) : 0; }
+        [[nodiscard]] int HorizontalWheelDelta() const { return (RawMouse.usButtonFlags & RI_MOUSE_HWHEEL) ? static_cast<int16_t>(RawMouse.usButtonData) : 0; }
 
         [[nodiscard]] ButtonIndex PressedButtons() const { return static_cast<ButtonIndex>(RawMouse.usButtonFlags & static_cast<uint32_t>(ButtonIndex::ButtonDownMask)); }
         [[nodiscard]] ButtonIndex ReleasedButtons() const { return static_cast<ButtonIndex>(RawMouse.usButtonFlags >> 1 & static_cast<uint32_t>(ButtonIndex::ButtonDownMask)); }
@@ -163,65 +718,599 @@ namespace ttsuki::librawinput
         [[nodiscard]] bool ButtonIsUp(ButtonIndex b) const { return (static_cast<uint32_t>(ReleasedButtons()) & static_cast<uint32_t>(b)) != 0; }
     };
 
+    /// Mouse input accumulated since the last drain.
+    struct RawInputMouseAccumulation
+    {
+        /// Count of accumulated events.
+        uint64_t EventCount{};
+
+        /// Sum of relative motion. Absolute motion is not summed.
+        int64_t X{};
+        int64_t Y{};
+
+        /// Sum of wheel deltas, in WHEEL_DELTA (120) per notch.
+        int64_t WheelDelta{};
+        int64_t HorizontalWheelDelta{};
+
+        /// Sum of whole notches (MouseEvent::WheelNotches).
+        int64_t WheelNotches{};
+        int64_t HorizontalWheelNotches{};
+
+        /// Buttons pressed or released at least once.
+        MouseEvent::ButtonIndex PressedButtons{};
+        MouseEvent::ButtonIndex ReleasedButtons{};
+
+        /// Buttons held after the last event.
+        MouseEvent::ButtonIndex HeldButtons{};
+
+        /// Last absolute position (0 to 65535), if absolute motion has been reported.
+        bool HasAbsolutePosition{};
+        int32_t AbsoluteX{};
+        int32_t AbsoluteY{};
+    };
+
+    enum struct MouseGestureKind : uint8_t
+    {
+        /// Released without dragging. ClickCount: 1 for a click, 2 for a double-click, and so on.
+        Click,
+
+        /// Pressed the second time within the double-click time and distance.
+        DoubleClick,
+
+        /// The double-click time has passed after a click without another press.
+        SingleClick,
+
+        /// Moved beyond the drag distance while pressed. X, Y: the pressed position.
+        DragStart,
+
+        /// Released after a drag.
+        DragEnd,
+    };
+
+    struct MouseGestureEvent
+    {
+        HANDLE Device;
+        TIMESTAMP Timestamp;
+        MouseGestureKind Kind;
+        MouseEvent::ButtonIndex Button;
+        uint32_t ClickCount;
+
+        /// Position in device units: accumulated relative motion, or the absolute position.
+        int32_t X;
+        int32_t Y;
+
+        [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+    };
+
+    enum struct MouseStrokeKind : uint8_t
+    {
+        /// Straight stroke.
+        Stroke,
+
+        /// Short and fast straight stroke.
+        Flick,
+
+        /// Closed loop turning about a full round.
+        Circle,
+
+        /// Matched one of MouseStrokeOptions::Templates.
+        Template,
+    };
+
+    struct MouseStrokeEvent
+    {
+        HANDLE Device;
+
+        /// Time the stroke ended.
+        TIMESTAMP Timestamp;
+        TIMESTAMP Duration;
+
+        MouseStrokeKind Kind;
+
+        /// Circle: drawn clockwise (on screen, +Y down).
+        bool Clockwise;
+
+        /// Template: matched MouseStrokeTemplate::Id and its score (0.0 to 1.0).
+        uint32_t TemplateId;
+        float Score;
+
+        /// Direction from the start to the end, in radians (0: right, +pi/2: down).
+        float Direction;
+
+        /// Path length in device units.
+        float Length;
+
+        [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+    };
+
+    /// Takes mouse input accumulated since the last drain, e.g. once per frame.
+    /// Accumulated for mice while the listener runs.
+    /// @param listener listener handle returned by StartRawInput
+    /// @param device mouse device handle, or nullptr for the sum of all mice
+    RawInputMouseAccumulation DrainRawInputMouseAccumulation(const std::shared_ptr<void>& listener, HANDLE device = nullptr);
+
+    /// Cursor of a mouse.
+    struct RawInputCursor
+    {
+        HANDLE Device;
+        float X;
+        float Y;
+
+        /// Buttons held now, and pressed or released since the last update.
+        MouseEvent::ButtonIndex Buttons;
+        MouseEvent::ButtonIndex PressedButtons;
+        MouseEvent::ButtonIndex ReleasedButtons;
+    };
+
+    /// Moves the cursors of all mice by their input since the last update, e.g. once per frame.
+    /// Each mouse has its own cursor, starting at the center of its rectangle. Cursors of removed mice are dropped.
+    /// Independent of DrainRawInputMouseAccumulation.
+    /// @param listener listener handle returned by StartRawInput
+    /// @returns cursors of mice which have sent input or have been configured
+    std::vector<RawInputCursor> UpdateRawInputCursors(const std::shared_ptr<void>& listener);
+
+    /// Changes settings of the cursor of a mouse. The cursor is clamped into the new rectangle.
+    /// @param listener listener handle returned by StartRawInput
+    /// @param device mouse device handle
+    /// @param options cursor settings
+    void ConfigureRawInputCursor(const std::shared_ptr<void>& listener, HANDLE device, const RawInputCursorOptions& options);
+
     struct HidDeviceCaps;
 
-    struct HidEvent
+    struct HidValueInput
+    {
+        uint16_t Page;
+        uint16_t Usage;
+        int32_t Value;
+        int32_t MinValue;
+        int32_t MaxValue;
+    };
+
+    struct HidButtonInput
+    {
+        uint16_t Page;
+        uint16_t FirstUsage;
+        uint16_t LastUsage;
+        uint16_t ButtonCount;
+        uint64_t ButtonStatuses;
+    };
+
+    /// Usage of a device resolved once, to read it from events of the device in constant time.
+    struct HidUsageHandle
+    {
+        static inline constexpr uint16_t kInvalidIndex = 0xFFFF;
+
+        uint16_t CapIndex{kInvalidIndex};
+        uint16_t Bit{}; // for buttons
+
+        [[nodiscard]] bool IsValid() const { return CapIndex != kInvalidIndex; }
+    };
+
+    /// Resolves a value usage of the device.
+    /// @returns invalid handle if the device has no such value.
+    HidUsageHandle ResolveHidValueUsage(const HidDeviceCaps* caps, uint16_t page, uint16_t usage);
+
+    /// Resolves a button usage of the device.
+    /// @returns invalid handle if the device has no such button.
+    HidUsageHandle ResolveHidButtonUsage(const HidDeviceCaps* caps, uint16_t page, uint16_t usage);
+
+    /// HID input event with fixed capacity of values and button pages.
+    /// Parse is explicitly instantiated for HidEvent, SmallHidEvent and LargeHidEvent.
+    template <size_t TMaxCountOfValues, size_t TMaxCountOfButtonPages>
+    struct BasicHidEvent
     {
         /// Constructs HidEvent from RAWINPUT.
-        [[nodiscard]] static HidEvent Parse(const RAWINPUT* input, TIMESTAMP timestamp, const HidDeviceCaps* caps);
+        [[nodiscard]] static BasicHidEvent Parse(const RAWINPUT* input, TIMESTAMP timestamp, const HidDeviceCaps* caps);
 
         HANDLE Device;
         TIMESTAMP Timestamp;
         RAWHID RawHid;
         const HidDeviceCaps* Caps;
 
-        struct ValueInput
-        {
-            uint16_t Page;
-            uint16_t Usage;
-            int32_t Value;
-            int32_t MinValue;
-            int32_t MaxValue;
-        };
+        using ValueInput = HidValueInput;
+        using ButtonInput = HidButtonInput;
 
-        struct ButtonInput
-        {
-            uint16_t Page;
-            uint16_t FirstUsage;
-            uint16_t LastUsage;
-            uint16_t ButtonCount;
-            uint64_t ButtonStatuses;
-        };
-
-        static inline constexpr size_t kMaxCountOfValues = 16;
-        static inline constexpr size_t kMaxCountOfButtonPages = 16;
+        static inline constexpr size_t kMaxCountOfValues = TMaxCountOfValues;
+        static inline constexpr size_t kMaxCountOfButtonPages = TMaxCountOfButtonPages;
         static inline constexpr size_t kMaxCountOfButtonsPerPage = 64;
 
         ARRAY<ValueInput, kMaxCountOfValues> Values;
         ARRAY<ButtonInput, kMaxCountOfButtonPages> Buttons;
 
+        /// Index of the device value cap of each Values entry.
+        std::array<uint8_t, kMaxCountOfValues> ValueCapIndices;
+
+        /// Values/Buttons index of each device cap. kNoSlot: not in this event.
+        static inline constexpr uint8_t kNoSlot = 0xFF;
+        std::array<uint8_t, kMaxCountOfValues> ValueSlots;
+        std::array<uint8_t, kMaxCountOfButtonPages> ButtonSlots;
+        static_assert(kMaxCountOfValues < kNoSlot && kMaxCountOfButtonPages < kNoSlot);
+
+        /// true: the device has more values or button pages than the capacity, and the rest are dropped.
+        bool Truncated;
+
         [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+
+        /// @returns value, or nullptr if the event does not have it.
+        [[nodiscard]] const ValueInput* Value(HidUsageHandle h) const
+        {
+            if (h.CapIndex >= kMaxCountOfValues) return nullptr;
+            const size_t slot = ValueSlots[h.CapIndex];
+            return slot < Values.size() ? &Values[slot] : nullptr;
+        }
+
+        /// @returns button state, or nullopt if the event does not have it.
+        [[nodiscard]] std::optional<bool> Button(HidUsageHandle h) const
+        {
+            if (h.CapIndex >= kMaxCountOfButtonPages) return std::nullopt;
+            const size_t slot = ButtonSlots[h.CapIndex];
+            return slot < Buttons.size() ? std::optional<bool>((Buttons[slot].ButtonStatuses >> h.Bit & 1) != 0) : std::nullopt;
+        }
+
+        [[nodiscard]] const ValueInput* Value(uint16_t page, uint16_t usage) const { return Value(ResolveHidValueUsage(Caps, page, usage)); }
+        [[nodiscard]] std::optional<bool> Button(uint16_t page, uint16_t usage) const { return Button(ResolveHidButtonUsage(Caps, page, usage)); }
+    };
+
+    enum struct JoystickAxis : uint32_t
+    {
+        X,
+        Y,
+        Z,
+        RotX,
+        RotY,
+        RotZ,
+        Slider0,
+        Slider1,
+        Slider2,
+        Slider3,
+        HatSwitch0,
+        HatSwitch1,
+        HatSwitch0X,
+        HatSwitch0Y,
+        HatSwitch1X,
+        HatSwitch1Y,
     };
 
+    static inline constexpr size_t kJoystickAxisCount = 16;
+
+    /// Joystick axes and buttons, normalized.
+    /// API change: axes used to be std::optional<float> data members (e.g. e.X), and are now accessors (e.X()) over Axes and AxisPresence.
+    /// Callers have to add the parentheses; the values and their presence are unchanged.
     struct JoystickHidEvent
     {
         /// Constructs JoystickHidEvent from HidEvent.
-        [[nodiscard]] static JoystickHidEvent FromHidEvent(const HidEvent& e);
+        template <size_t TMaxCountOfValues, size_t TMaxCountOfButtonPages>
+        [[nodiscard]] static JoystickHidEvent FromHidEvent(const BasicHidEvent<TMaxCountOfValues, TMaxCountOfButtonPages>& e);
+
+        HANDLE Device;
+        TIMESTAMP Timestamp;
+
+        /// Bit (1 << JoystickAxis) is set when the axis is present.
+        uint32_t AxisPresence;
+
+        /// Axis values indexed by JoystickAxis. Absent axes are 0.
+        alignas(16) std::array<float, kJoystickAxisCount> Axes;
+
+        uint32_t ButtonCount;
+        std::bitset<64> Buttons;
+
+        [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+
+        [[nodiscard]] bool HasAxis(JoystickAxis a) const { return (AxisPresence >> static_cast<uint32_t>(a) & 1u) != 0; }
+        [[nodiscard]] std::optional<float> Axis(JoystickAxis a) const { return HasAxis(a) ? std::optional<float>(Axes[static_cast<size_t>(a)]) : std::nullopt; }
+        void SetAxis(JoystickAxis a, float value) { Axes[static_cast<size_t>(a)] = value, AxisPresence |= 1u << static_cast<uint32_t>(a); }
+
+        [[nodiscard]] std::optional<float> X() const { return Axis(JoystickAxis::X); }
+        [[nodiscard]] std::optional<float> Y() const { return Axis(JoystickAxis::Y); }
+        [[nodiscard]] std::optional<float> Z() const { return Axis(JoystickAxis::Z); }
+        [[nodiscard]] std::optional<float> RotX() const { return Axis(JoystickAxis::RotX); }
+        [[nodiscard]] std::optional<float> RotY() const { return Axis(JoystickAxis::RotY); }
+        [[nodiscard]] std::optional<float> RotZ() const { return Axis(JoystickAxis::RotZ); }
+        [[nodiscard]] std::optional<float> Slider0() const { return Axis(JoystickAxis::Slider0); }
+        [[nodiscard]] std::optional<float> Slider1() const { return Axis(JoystickAxis::Slider1); }
+        [[nodiscard]] std::optional<float> Slider2() const { return Axis(JoystickAxis::Slider2); }
+        [[nodiscard]] std::optional<float> Slider3() const { return Axis(JoystickAxis::Slider3); }
+        [[nodiscard]] std::optional<float> HatSwitch0() const { return Axis(JoystickAxis::HatSwitch0); }
+        [[nodiscard]] std::optional<float> HatSwitch1() const { return Axis(JoystickAxis::HatSwitch1); }
+        [[nodiscard]] std::optional<float> HatSwitch0X() const { return Axis(JoystickAxis::HatSwitch0X); }
+        [[nodiscard]] std::optional<float> HatSwitch0Y() const { return Axis(JoystickAxis::HatSwitch0Y); }
+        [[nodiscard]] std::optional<float> HatSwitch1X() const { return Axis(JoystickAxis::HatSwitch1X); }
+        [[nodiscard]] std::optional<float> HatSwitch1Y() const { return Axis(JoystickAxis::HatSwitch1Y); }
+    };
+
+    /// JoystickHidEvent in 16-bit fixed point.
+    /// Signed axes (X to RotZ, HatSwitchNX/Y) are in -32767 to +32767 for -1.0 to +1.0.
+    /// Unsigned axes (Slider0 to Slider3, HatSwitchN) are in 0 to 65535 for 0.0 to 1.0.
+    struct FixedJoystickHidEvent
+    {
+        /// Constructs FixedJoystickHidEvent from HidEvent with the scale factors precomputed in the device caps.
+        template <size_t TMaxCountOfValues, size_t TMaxCountOfButtonPages>
+        [[nodiscard]] static FixedJoystickHidEvent FromHidEvent(const BasicHidEvent<TMaxCountOfValues, TMaxCountOfButtonPages>& e);
+
+        static inline constexpr int32_t kSignedOne = 32767;
+        static inline constexpr int32_t kUnsignedOne = 65535;
+
+        HANDLE Device;
+        TIMESTAMP Timestamp;
+
+        /// Bit (1 << JoystickAxis) is set when the axis is present.
+        uint32_t AxisPresence;
+
+        /// Axis values indexed by JoystickAxis, as int16_t or uint16_t bit patterns. Absent axes are 0.
+        alignas(16) std::array<uint16_t, kJoystickAxisCount> Axes;
+
+        uint32_t ButtonCount;
+        std::bitset<64> Buttons;
+
+        [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+
+        [[nodiscard]] static constexpr bool IsSignedAxis(JoystickAxis a) { return a < JoystickAxis::Slider0 || a > JoystickAxis::HatSwitch1; }
+        [[nodiscard]] bool HasAxis(JoystickAxis a) const { return (AxisPresence >> static_cast<uint32_t>(a) & 1u) != 0; }
+        [[nodiscard]] std::optional<int16_t> SignedAxis(JoystickAxis a) const { return HasAxis(a) ? std::optional<int16_t>(static_cast<int16_t>(Axes[static_cast<size_t>(a)])) : std::nullopt; }
+        [[nodiscard]] std::optional<uint16_t> UnsignedAxis(JoystickAxis a) const { return HasAxis(a) ? std::optional<uint16_t>(Axes[static_cast<size_t>(a)]) : std::nullopt; }
+        void SetAxis(JoystickAxis a, uint16_t bits) { Axes[static_cast<size_t>(a)] = bits, AxisPresence |= 1u << static_cast<uint32_t>(a); }
+
+        [[nodiscard]] std::optional<int16_t> X() const { return SignedAxis(JoystickAxis::X); }
+        [[nodiscard]] std::optional<int16_t> Y() const { return SignedAxis(JoystickAxis::Y); }
+        [[nodiscard]] std::optional<int16_t> Z() const { return SignedAxis(JoystickAxis::Z); }
+        [[nodiscard]] std::optional<int16_t> RotX() const { return SignedAxis(JoystickAxis::RotX); }
+        [[nodiscard]] std::optional<int16_t> RotY() const { return SignedAxis(JoystickAxis::RotY); }
+        [[nodiscard]] std::optional<int16_t> RotZ() const { return SignedAxis(JoystickAxis::RotZ); }
+        [[nodiscard]] std::optional<uint16_t> Slider0() const { return UnsignedAxis(JoystickAxis::Slider0); }
+        [[nodiscard]] std::optional<uint16_t> Slider1() const { return UnsignedAxis(JoystickAxis::Slider1); }
+        [[nodiscard]] std::optional<uint16_t> Slider2() const { return UnsignedAxis(JoystickAxis::Slider2); }
+        [[nodiscard]] std::optional<uint16_t> Slider3() const { return UnsignedAxis(JoystickAxis::Slider3); }
+        [[nodiscard]] std::optional<uint16_t> HatSwitch0() const { return UnsignedAxis(JoystickAxis::HatSwitch0); }
+        [[nodiscard]] std::optional<uint16_t> HatSwitch1() const { return UnsignedAxis(JoystickAxis::HatSwitch1); }
+        [[nodiscard]] std::optional<int16_t> HatSwitch0X() const { return SignedAxis(JoystickAxis::HatSwitch0X); }
+        [[nodiscard]] std::optional<int16_t> HatSwitch0Y() const { return SignedAxis(JoystickAxis::HatSwitch0Y); }
+        [[nodiscard]] std::optional<int16_t> HatSwitch1X() const { return SignedAxis(JoystickAxis::HatSwitch1X); }
+        [[nodiscard]] std::optional<int16_t> HatSwitch1Y() const { return SignedAxis(JoystickAxis::HatSwitch1Y); }
+    };
+
+    enum struct TouchContactPhase : uint8_t
+    {
+        Down, // touched in this frame
+        Move, // still touching
+        Up,   // lifted in this frame
+    };
+
+    struct TouchContact
+    {
+        uint32_t ContactId;
+        TouchContactPhase Phase;
+
+        /// Position normalized to 0.0 to 1.0 by the logical range of the device.
+        float X;
+        float Y;
+
+        /// Contact size in the same scale as X and Y. 0 if not reported.
+        float Width;
+        float Height;
+
+        /// Pressure normalized to 0.0 to 1.0. 0 if not reported.
+        float Pressure;
+
+        /// Time the contact has touched down.
+        TIMESTAMP DownTimestamp;
+    };
+
+    /// Contacts of a touch pad or touch screen in a frame.
+    /// A frame may span several reports (hybrid mode), and is delivered once all of its contacts are received.
+    struct TouchEvent
+    {
+        static inline constexpr size_t kMaxCountOfContacts = 10;
+
+        HANDLE Device;
+        TIMESTAMP Timestamp;
+
+        /// Device scan time of the frame in 100 microseconds, wraps around. 0 if not reported.
+        uint32_t ScanTime;
+
+        ARRAY<TouchContact, kMaxCountOfContacts> Contacts;
+
+        [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+    };
+
+    /// Pen (stylus) sample.
+    struct PenEvent
+    {
+        HANDLE Device;
+        TIMESTAMP Timestamp;
+
+        /// Position normalized to 0.0 to 1.0 by the logical range of the device.
+        float X;
+        float Y;
+
+        /// Tip pressure normalized to 0.0 to 1.0. 0 if not reported.
+        float Pressure;
+
+        /// Tilt in degrees, mapped from the logical range to -90 to +90. 0 if not reported.
+        float TiltX;
+        float TiltY;
+
+        bool InRange;         // hovering or touching
+        bool Tip;             // touching
+        bool Barrel;          // barrel button
+        bool SecondaryBarrel; // second barrel button
+        bool Eraser;          // eraser tip touching
+        bool Invert;          // eraser end is toward the surface
+
+        [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+    };
+
+    /// Consumer control report (usage page 0x0C).
+    struct ConsumerControlEvent
+    {
+        static inline constexpr size_t kMaxCountOfUsages = 16;
+        static inline constexpr size_t kMaxCountOfEncoders = 4;
+
+        struct Encoder
+        {
+            uint16_t Usage;
+            int32_t Delta;
+        };
 
         HANDLE Device;
         TIMESTAMP Timestamp;
-        std::optional<float> X, Y, Z;
-        std::optional<float> RotX, RotY, RotZ;
-        std::optional<float> Slider0, Slider1, Slider2, Slider3;
-        std::optional<float> HatSwitch0, HatSwitch1;
-        std::optional<float> HatSwitch0X, HatSwitch0Y;
-        std::optional<float> HatSwitch1X, HatSwitch1Y;
+
+        /// Consumer usages pressed in the report (e.g. 0xCD: Play/Pause, 0xE9: Volume Increment). Truncated to kMaxCountOfUsages.
+        ARRAY<uint16_t, kMaxCountOfUsages> Pressed;
+
+        /// Relative values (e.g. 0xE0: Volume knob), summed by usage.
+        ARRAY<Encoder, kMaxCountOfEncoders> Encoders;
+
+        [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+
+        [[nodiscard]] bool IsPressed(uint16_t usage) const
+        {
+            for (uint16_t u : Pressed) if (u == usage) return true;
+            return false;
+        }
+
+        [[nodiscard]] int32_t Delta(uint16_t usage) const
+        {
+            for (const Encoder& e : Encoders) if (e.Usage == usage) return e.Delta;
+            return 0;
+        }
+    };
+
+    /// Inertial measurement sample of an accelerometer and/or a gyrometer on the sensor page (0x20).
+    struct ImuEvent
+    {
+        HANDLE Device;
+
+        /// Sample time. Reports arriving together in a message are spread back over the estimated report interval.
+        TIMESTAMP Timestamp;
+
+        bool HasAcceleration;
+        bool HasAngularVelocity;
+        bool HasOrientation;
+
+        /// Acceleration (X, Y, Z) in G.
+        std::array<float, 3> Acceleration;
+
+        /// Angular velocity (X, Y, Z) in degrees per second.
+        std::array<float, 3> AngularVelocity;
+
+        /// Orientation quaternion (W, X, Y, Z) fused from the samples so far. Requires RawInputListenerOptions::ImuOrientationFilter.
+        std::array<float, 4> Orientation;
+
+        [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+    };
+
+    enum struct StandardGamepadButton : uint32_t
+    {
+        South, // A (Xbox), Cross (PlayStation)
+        East,  // B, Circle
+        West,  // X, Square
+        North, // Y, Triangle
+        Back,
+        Guide,
+        Start,
+        LeftStick,
+        RightStick,
+        LeftShoulder,
+        RightShoulder,
+        DpadUp,
+        DpadDown,
+        DpadLeft,
+        DpadRight,
+        Misc1,
+        Paddle1,
+        Paddle2,
+        Paddle3,
+        Paddle4,
+        Touchpad,
+    };
+
+    static inline constexpr size_t kStandardGamepadButtonCount = 21;
+
+    enum struct StandardGamepadAxis : uint32_t
+    {
+        LeftX,
+        LeftY,
+        RightX,
+        RightY,
+        LeftTrigger,
+        RightTrigger,
+    };
+
+    static inline constexpr size_t kStandardGamepadAxisCount = 6;
+
+    /// Gamepad state in the standard layout.
+    struct StandardGamepadEvent
+    {
+        HANDLE Device;
+        TIMESTAMP Timestamp;
+
+        /// Bit (1 << StandardGamepadButton) is set while the button is pressed.
+        uint32_t Buttons;
+
+        /// Sticks in -32767 to +32767 (+X: right, +Y: down), triggers in 0 to 32767. Indexed by StandardGamepadAxis.
+        std::array<int16_t, kStandardGamepadAxisCount> Axes;
+
+        [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+
+        [[nodiscard]] bool IsPressed(StandardGamepadButton b) const { return (Buttons >> static_cast<uint32_t>(b) & 1u) != 0; }
+
+        /// Sticks in -1.0 to +1.0, triggers in 0.0 to 1.0.
+        [[nodiscard]] float Axis(StandardGamepadAxis a) const { return static_cast<float>(Axes[static_cast<size_t>(a)]) / 32767.0f; }
+    };
+
+    static_assert(sizeof(StandardGamepadEvent) <= 64, "StandardGamepadEvent fits in a cache line.");
+
+    /// Racing wheel and pedals state.
+    struct WheelEvent
+    {
+        /// Wheel device, or the first device of merged devices.
+        HANDLE Device;
+        TIMESTAMP Timestamp;
+
+        bool HasSteering;
+        bool HasAccelerator;
+        bool HasBrake;
+        bool HasClutch;
+
+        /// Steering in the full resolution of the device.
+        int32_t SteeringValue;
+        int32_t SteeringMin;
+        int32_t SteeringMax;
+
+        /// Steering normalized to -1.0 (left) to +1.0 (right) around the center of the logical range.
+        double Steering;
+
+        /// Pedals normalized to 0.0 to 1.0 by the logical range of the device.
+        float Accelerator;
+        float Brake;
+        float Clutch;
+
+        /// Buttons including shifter positions.
         uint32_t ButtonCount;
         std::bitset<64> Buttons;
 
         [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
     };
 
+    /// 6-DOF multi-axis controller frame.
+    /// Devices sending translation and rotation in separate reports are merged into one frame.
+    struct MultiAxisEvent
+    {
+        HANDLE Device;
+        TIMESTAMP Timestamp;
+
+        /// Translation (X, Y, Z) normalized to -1.0 to +1.0, multiplied by the sensitivity.
+        std::array<float, 3> Translation;
+
+        /// Rotation (X, Y, Z) normalized to -1.0 to +1.0, multiplied by the sensitivity.
+        std::array<float, 3> Rotation;
+
+        uint32_t ButtonCount;
+        std::bitset<32> Buttons;
+
+        [[nodiscard]] double ElapsedTimeSec() const { return static_cast<double>(Clock() - Timestamp) / 1000000.0; }
+    };
+
     static inline std::underlying_type_t<RawInputDeviceType> operator +(RawInputDeviceType a) { return static_cast<std::underlying_type_t<RawInputDeviceType>>(a); }
     static inline bool operator !(RawInputDeviceType a) { return !+a; }
     static inline RawInputDeviceType operator ~(RawInputDeviceType a) { return static_cast<RawInputDeviceType>(~+a); }
@@ -0,0 +1,1007 @@
+/// @file
+/// @brief  librawinput internals: input stages which take time from the caller.
+/// @author ttsuki
+
+// Licensed under the MIT License.
+// Copyright (c) 2019-2023 ttsuki All rights reserved.
+
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include "librawinput.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <array>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+namespace ttsuki::librawinput
+{
+    /// Epoch-based reclamation of objects shared with readers, e.g. device caps.
+    /// Removed objects are retired with the current epoch and freed once every reader which might reference them has left,
+    /// so removal never waits for readers.
+    /// Readers enter an epoch while the objects are known to be alive: on the capture thread, or while holding another pin.
+    /// Readers beyond the slot table share an overflow count, which holds back all reclamation while non-zero.
+    template <class TRetired>
+    class EpochDomain final
+    {
+    public:
+        static inline constexpr size_t kMaxReaders = 64;
+        static inline constexpr size_t kOverflowSlot = kMaxReaders;
+        static inline constexpr size_t kInvalidSlot = ~size_t{};
+
+    private:
+        std::atomic<uint64_t> epoch_{1};
+        std::array<std::atomic<uint64_t>, kMaxReaders> readers_{}; // pinned epoch. 0: free slot
+        std::atomic<uint32_t> overflow_readers_{};
+        std::vector<std::pair<uint64_t, std::unique_ptr<TRetired>>> retired_{}; // capture thread only
+
+    public:
+        /// Pins the current epoch. Never blocks.
+        /// @returns reader slot, or kOverflowSlot if all slots are in use
+        size_t Enter()
+        {
+            for (size_t i = 0; i < readers_.size(); i++)
+            {
+                uint64_t expected = 0;
+                if (readers_[i].compare_exchange_strong(expected, epoch_.load()))
+                    return i;
+            }
+
+            overflow_readers_.fetch_add(1);
+            return kOverflowSlot;
+        }
+
+        void Leave(size_t slot)
+        {
+            if (slot == kOverflowSlot)
+                overflow_readers_.fetch_sub(1);
+            else
+                readers_[slot].store(0);
+        }
+
+        /// @returns true if some retired objects are not freed yet. Called on the capture thread.
+        [[nodiscard]] bool HasRetired() const noexcept { return !retired_.empty(); }
+
+        /// Retires an object removed from the readers' view. Called on the capture thread.
+        void Retire(std::unique_ptr<TRetired> retired)
+        {
+            if (retired) retired_.emplace_back(epoch_.fetch_add(1), std::move(retired));
+            Reclaim();
+        }
+
+        /// Frees retired objects which no reader can reference. Called on the capture thread.
+        void Reclaim()
+        {
+            if (retired_.empty()) return;
+            if (overflow_readers_.load() != 0) return;
+
+            uint64_t oldest = ~uint64_t{};
+            for (auto&& reader : readers_)
+                if (uint64_t e = reader.load(); e != 0 && e < oldest)
+                    oldest = e;
+
+            retired_.erase(
+                std::remove_if(retired_.begin(), retired_.end(), [oldest](const auto& r) { return r.first < oldest; }),
+                retired_.end());
+        }
+    };
+
+    /// Tracks the key-state bitmap of a keyboard.
+    struct KeyboardStateTracker
+    {
+        RawInputKeyboardStatistics Statistics{};
+
+        void Feed(const RAWKEYBOARD& k)
+        {
+            if (k.MakeCode == KEYBOARD_OVERRUN_MAKE_CODE)
+            {
+                Statistics.OverrunCount++;
+                return;
+            }
+
+            const KeyId id = ToKeyId(k.MakeCode, k.Flags, k.VKey);
+            if (id == KeyId::None) return;
+
+            const size_t bit = static_cast<size_t>(id);
+            const bool was_pressed = Statistics.PressedKeys.test(bit);
+            if (k.Flags & RI_KEY_BREAK)
+            {
+                if (!was_pressed) Statistics.ImpossibleReleaseCount++;
+                Statistics.PressedKeys.reset(bit);
+            }
+            else
+            {
+                if (was_pressed) Statistics.AutoRepeatCount++;
+                else Statistics.KeyDownCount++;
+                Statistics.PressedKeys.set(bit);
+            }
+
+            Statistics.PressedKeyCount = static_cast<uint32_t>(Statistics.PressedKeys.count());
+            Statistics.MaxRollover = std::max(Statistics.MaxRollover, Statistics.PressedKeyCount);
+        }
+    };
+
+    /// Hashed timer wheel: timers are put in slots by the first tick at or after their deadline, and fired by advancing the wheel.
+    /// Deadlines beyond a round stay in their slot until the round comes.
+    template <class TTimer>
+    class TimerWheel final
+    {
+        static constexpr size_t kSlotCount = 64;
+
+        struct Entry
+        {
+            TIMESTAMP Tick; // fires when the wheel reaches this tick
+            TIMESTAMP Deadline;
+            TTimer Timer;
+        };
+
+        TIMESTAMP tick_;
+        TIMESTAMP current_tick_{};
+        size_t count_{};
+        std::array<std::vector<Entry>, kSlotCount> slots_{};
+        std::vector<Entry> fired_{};
+
+    public:
+        explicit TimerWheel(TIMESTAMP tick) : tick_(tick) { }
+
+        [[nodiscard]] TIMESTAMP Tick() const { return tick_; }
+        [[nodiscard]] bool Empty() const { return count_ == 0; }
+
+        void Schedule(TIMESTAMP deadline, TTimer timer)
+        {
+            // Rounds the deadline up, so that a timer fired at its tick has always expired.
+            const TIMESTAMP tick = std::max((deadline + tick_ - 1) / tick_, current_tick_ + 1);
+            slots_[tick % kSlotCount].push_back(Entry{tick, deadline, std::move(timer)});
+            count_++;
+        }
+
+        /// Fires timers whose deadline has come. Timers may be scheduled from the callback.
+        template <class TFire>
+        void Advance(TIMESTAMP now, TFire&& fire)
+        {
+            const TIMESTAMP target_tick = now / tick_;
+            if (target_tick <= current_tick_) return;
+
+            const TIMESTAMP steps = std::min<TIMESTAMP>(target_tick - current_tick_, kSlotCount);
+            for (TIMESTAMP i = 1; i <= steps && count_ != 0; i++)
+            {
+                std::vector<Entry>& slot = slots_[(current_tick_ + i) % kSlotCount];
+                for (size_t j = 0; j < slot.size();)
+                {
+                    if (slot[j].Tick <= target_tick)
+                    {
+                        fired_.push_back(std::move(slot[j]));
+                        slot[j] = std::move(slot.back());
+                        slot.pop_back();
+                        count_--;
+                    }
+                    else j++;
+                }
+            }
+            current_tick_ = target_tick;
+
+            for (Entry& e : fired_) fire(e.Timer, e.Deadline);
+            fired_.clear();
+        }
+    };
+
+    /// Detects clicks, double-clicks and drags of mouse buttons. Time is given by the caller.
+    class MouseGestureRecognizer final
+    {
+        static constexpr size_t kButtonCount = 5;
+
+        struct ButtonState
+        {
+            bool Down{};
+            bool Dragging{};
+            int32_t PressX{};
+            int32_t PressY{};
+            uint32_t ClickCount{};
+            TIMESTAMP LastClickTime{};
+            int32_t LastClickX{};
+            int32_t LastClickY{};
+            uint32_t TimerGeneration{}; // outdates scheduled timers
+        };
+
+        struct DeviceState
+        {
+            int32_t X{};
+            int32_t Y{};
+            std::array<ButtonState, kButtonCount> Buttons{};
+        };
+
+        /// Ends the click sequence of the button, unless it has been continued since scheduled.
+        struct SequenceTimer
+        {
+            HANDLE Device;
+            uint8_t Button;
+            uint32_t Generation;
+        };
+
+        MouseGestureOptions options_;
+        std::unordered_map<HANDLE, DeviceState> devices_{};
+        TimerWheel<SequenceTimer> timers_{10000};
+
+        static MouseEvent::ButtonIndex ButtonOf(size_t i) { return static_cast<MouseEvent::ButtonIndex>(RI_MOUSE_LEFT_BUTTON_DOWN << (i * 2)); }
+
+        static bool Within(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t distance)
+        {
+            const int64_t dx = static_cast<int64_t>(x1) - x0;
+            const int64_t dy = static_cast<int64_t>(y1) - y0;
+            return dx * dx + dy * dy <= static_cast<int64_t>(distance) * distance;
+        }
+
+    public:
+        explicit MouseGestureRecognizer(MouseGestureOptions options) : options_(options) { }
+
+        [[nodiscard]] bool HasPendingTimers() const { return !timers_.Empty(); }
+
+        template <class TEmit>
+        void Feed(const MouseEvent& e, TIMESTAMP now, TEmit&& emit)
+        {
+            DeviceState& d = devices_[e.Device];
+            const auto make = [&](MouseGestureKind kind, size_t i, uint32_t click_count, int32_t x, int32_t y)
+            {
+                return MouseGestureEvent{e.Device, now, kind, ButtonOf(i), click_count, x, y};
+            };
+
+            if (e.LastXYIsAbsolute())
+                d.X = e.LastX(), d.Y = e.LastY();
+            else
+                d.X += e.LastX(), d.Y += e.LastY();
+
+            for (size_t i = 0; i < kButtonCount; i++)
+            {
+                ButtonState& b = d.Buttons[i];
+                if (b.Down && !b.Dragging && !Within(b.PressX, b.PressY, d.X, d.Y, options_.DragDistance))
+                {
+                    b.Dragging = true;
+                    b.ClickCount = 0;
+                    emit(make(MouseGestureKind::DragStart, i, 0, b.PressX, b.PressY));
+                }
+
+                if (e.ButtonIsDown(ButtonOf(i)) && !b.Down)
+                {
+                    const bool continued = b.ClickCount != 0
+                        && now - b.LastClickTime <= options_.DoubleClickTime
+                        && Within(b.LastClickX, b.LastClickY, d.X, d.Y, options_.DoubleClickDistance);
+                    b.ClickCount = continued ? b.ClickCount : 0;
+                    b.TimerGeneration++;
+                    b.Down = true;
+                    b.PressX = d.X;
+                    b.PressY = d.Y;
+                    if (continued && b.ClickCount == 1)
+                        emit(make(MouseGestureKind::DoubleClick, i, 2, d.X, d.Y));
+                }
+
+                if (e.ButtonIsUp(ButtonOf(i)) && b.Down)
+                {
+                    b.Down = false;
+                    if (b.Dragging)
+                    {
+                        b.Dragging = false;
+                        emit(make(MouseGestureKind::DragEnd, i, 0, d.X, d.Y));
+                        continue;
+                    }
+
+                    b.ClickCount++;
+                    b.LastClickTime = now;
+                    b.LastClickX = d.X;
+                    b.LastClickY = d.Y;
+                    timers_.Schedule(now + options_.DoubleClickTime, SequenceTimer{e.Device, static_cast<uint8_t>(i), b.TimerGeneration});
+                    emit(make(MouseGestureKind::Click, i, b.ClickCount, d.X, d.Y));
+                }
+            }
+        }
+
+        /// Ends click sequences whose double-click time has passed.
+        template <class TEmit>
+        void Advance(TIMESTAMP now, TEmit&& emit)
+        {
+            timers_.Advance(now, [&](const SequenceTimer& t, TIMESTAMP deadline)
+            {
+                auto it = devices_.find(t.Device);
+                if (it == devices_.end()) return;
+
+                ButtonState& b = it->second.Buttons[t.Button];
+                if (b.TimerGeneration != t.Generation || b.Down) return;
+
+                if (b.ClickCount == 1)
+                    emit(MouseGestureEvent{t.Device, deadline, MouseGestureKind::SingleClick, ButtonOf(t.Button), 1, b.LastClickX, b.LastClickY});
+                b.ClickCount = 0;
+            });
+        }
+
+        void Remove(HANDLE device) { devices_.erase(device); }
+    };
+
+    /// Recognizes strokes from relative mouse motion incrementally.
+    /// A stroke keeps at most kPointCount points: when full, every other point is dropped and the sampling spacing doubles.
+    /// Strokes are resampled to kPointCount points only when they end, and matched against templates normalized likewise.
+    class MouseStrokeRecognizer final
+    {
+        static constexpr size_t kPointCount = 32;
+        static constexpr float kInitialSpacing = 2.0f;
+        static constexpr float kPi = 3.14159265358979f;
+
+        struct StrokeState
+        {
+            bool Active{};
+            TIMESTAMP StartTime{};
+            TIMESTAMP LastMotionTime{};
+            float X{}; // position from the start
+            float Y{};
+            float Length{};
+            float Spacing{kInitialSpacing};
+            float Turning{}; // signed sum of turns between sampled segments
+            float LastAngle{};
+            bool HasLastAngle{};
+            uint32_t Count{};
+            std::array<float, kPointCount> Xs{};
+            std::array<float, kPointCount> Ys{};
+            uint32_t TimerGeneration{};
+        };
+
+        /// Ends the stroke after a pause, unless it has been moved or ended since.
+        struct GapTimer
+        {
+            HANDLE Device;
+            uint32_t Generation;
+        };
+
+        MouseStrokeOptions options_;
+        std::unordered_map<HANDLE, StrokeState> strokes_{};
+        TimerWheel<GapTimer> timers_{10000};
+
+        // Templates, resampled and normalized: [template][point]
+        std::vector<uint32_t> template_ids_{};
+        std::vector<float> template_xs_{};
+        std::vector<float> template_ys_{};
+
+        /// Resamples a polyline to kPointCount points equally spaced along the path.
+        static void Resample(const float* xs, const float* ys, size_t count, float* out_xs, float* out_ys)
+        {
+            if (count == 0)
+            {
+                std::fill_n(out_xs, kPointCount, 0.0f);
+                std::fill_n(out_ys, kPointCount, 0.0f);
+                return;
+            }
+
+            float total = 0.0f;
+            for (size_t i = 1; i < count; i++)
+                total += std::hypot(xs[i] - xs[i - 1], ys[i] - ys[i - 1]);
+            const float interval = total / static_cast<float>(kPointCount - 1);
+
+            out_xs[0] = xs[0];
+            out_ys[0] = ys[0];
+            size_t j = 1;
+            float walked = 0.0f;
+            for (size_t i = 1; i < count && j < kPointCount; i++)
+            {
+                const float d = std::hypot(xs[i] - xs[i - 1], ys[i] - ys[i - 1]);
+                while (j < kPointCount && walked + d >= interval * static_cast<float>(j))
+                {
+                    const float t = d > 0.0f ? (interval * static_cast<float>(j) - walked) / d : 0.0f;
+                    out_xs[j] = xs[i - 1] + (xs[i] - xs[i - 1]) * t;
+                    out_ys[j] = ys[i - 1] + (ys[i] - ys[i - 1]) * t;
+                    j++;
+                }
+                walked += d;
+            }
+            for (; j < kPointCount; j++)
+            {
+                out_xs[j] = xs[count - 1];
+                out_ys[j] = ys[count - 1];
+            }
+        }
+
+        /// Moves the centroid to the origin and scales to the unit RMS radius.
+        static void Normalize(float* xs, float* ys)
+        {
+            float cx = 0.0f, cy = 0.0f;
+            for (size_t i = 0; i < kPointCount; i++) cx += xs[i], cy += ys[i];
+            cx /= static_cast<float>(kPointCount);
+            cy /= static_cast<float>(kPointCount);
+
+            float r2 = 0.0f;
+            for (size_t i = 0; i < kPointCount; i++)
+            {
+                xs[i] -= cx;
+                ys[i] -= cy;
+                r2 += xs[i] * xs[i] + ys[i] * ys[i];
+            }
+
+            const float scale = r2 > 0.0f ? 1.0f / std::sqrt(r2 / static_cast<float>(kPointCount)) : 0.0f;
+            for (size_t i = 0; i < kPointCount; i++) xs[i] *= scale, ys[i] *= scale;
+        }
+
+        void AddPoint(StrokeState& s)
+        {
+            if (s.Count == kPointCount)
+            {
+                for (uint32_t i = 0; i < kPointCount / 2; i++)
+                    s.Xs[i] = s.Xs[i * 2], s.Ys[i] = s.Ys[i * 2];
+                s.Count = kPointCount / 2;
+                s.Spacing *= 2.0f;
+            }
+
+            if (s.Count != 0)
+            {
+                const float angle = std::atan2(s.Y - s.Ys[s.Count - 1], s.X - s.Xs[s.Count - 1]);
+                if (s.HasLastAngle)
+                {
+                    float turn = angle - s.LastAngle;
+                    if (turn > kPi) turn -= 2.0f * kPi;
+                    if (turn < -kPi) turn += 2.0f * kPi;
+                    s.Turning += turn;
+                }
+                s.LastAngle = angle;
+                s.HasLastAngle = true;
+            }
+
+            s.Xs[s.Count] = s.X;
+            s.Ys[s.Count] = s.Y;
+            s.Count++;
+        }
+
+        template <class TEmit>
+        void End(HANDLE device, StrokeState& s, TIMESTAMP end_time, TEmit&& emit)
+        {
+            s.Active = false;
+            s.TimerGeneration++;
+            if (s.Length < options_.MinStrokeLength) return;
+
+            if (s.Xs[s.Count - 1] != s.X || s.Ys[s.Count - 1] != s.Y)
+                AddPoint(s);
+
+            MouseStrokeEvent r{};
+            r.Device = device;
+            r.Timestamp = end_time;
+            r.Duration = end_time - s.StartTime;
+            r.Direction = std::atan2(s.Y, s.X);
+            r.Length = s.Length;
+
+            const float chord = std::hypot(s.X, s.Y);
+
+            // Templates
+            if (!template_ids_.empty())
+            {
+                std::array<float, kPointCount> xs, ys;
+                Resample(s.Xs.data(), s.Ys.data(), s.Count, xs.data(), ys.data());
+                Normalize(xs.data(), ys.data());
+
+                size_t best = 0;
+                float best_d2 = std::numeric_limits<float>::max();
+                for (size_t t = 0; t < template_ids_.size(); t++)
+                {
+                    const float* tx = template_xs_.data() + t * kPointCount;
+                    const float* ty = template_ys_.data() + t * kPointCount;
+                    float d2 = 0.0f;
+                    for (size_t i = 0; i < kPointCount; i++)
+                        d2 += (xs[i] - tx[i]) * (xs[i] - tx[i]) + (ys[i] - ty[i]) * (ys[i] - ty[i]);
+                    if (d2 < best_d2) best_d2 = d2, best = t;
+                }
+
+                // Both are in unit RMS radius: the RMS distance is 0.0 to 2.0.
+                const float score = 1.0f - std::sqrt(best_d2 / static_cast<float>(kPointCount)) / 2.0f;
+                if (score >= options_.MinTemplateScore)
+                {
+                    r.Kind = MouseStrokeKind::Template;
+                    r.TemplateId = template_ids_[best];
+                    r.Score = score;
+                    emit(r);
+                    return;
+                }
+            }
+
+            // A full round, closed within a third of the diameter.
+            if (std::abs(s.Turning) >= 1.7f * kPi && chord <= s.Length / kPi / 3.0f)
+            {
+                r.Kind = MouseStrokeKind::Circle;
+                r.Clockwise = s.Turning > 0.0f; // +Y down
+                emit(r);
+                return;
+            }
+
+            if (chord >= s.Length * 0.9f)
+            {
+                const bool fast = r.Duration > 0 && r.Duration <= options_.FlickMaxTime
+                    && s.Length * 1000000.0f / static_cast<float>(r.Duration) >= options_.FlickMinSpeed;
+                r.Kind = fast ? MouseStrokeKind::Flick : MouseStrokeKind::Stroke;
+                emit(r);
+            }
+        }
+
+    public:
+        explicit MouseStrokeRecognizer(MouseStrokeOptions options) : options_(std::move(options))
+        {
+            for (const MouseStrokeTemplate& t : options_.Templates)
+            {
+                if (t.Points.size() < 2) continue;
+
+                std::vector<float> xs, ys;
+                for (const auto& p : t.Points) xs.push_back(p[0]), ys.push_back(p[1]);
+
+                const size_t offset = template_xs_.size();
+                template_xs_.resize(offset + kPointCount);
+                template_ys_.resize(offset + kPointCount);
+                Resample(xs.data(), ys.data(), xs.size(), template_xs_.data() + offset, template_ys_.data() + offset);
+                Normalize(template_xs_.data() + offset, template_ys_.data() + offset);
+                template_ids_.push_back(t.Id);
+            }
+            options_.Templates.clear();
+        }
+
+        [[nodiscard]] bool HasPendingTimers() const { return !timers_.Empty(); }
+
+        template <class TEmit>
+        void Feed(const MouseEvent& e, TIMESTAMP now, TEmit&& emit)
+        {
+            StrokeState& s = strokes_[e.Device];
+            const uint32_t trigger = options_.TriggerButton;
+
+            // Trigger button release, or a pause: ends the stroke.
+            if (s.Active && (trigger ? (e.RawMouse.usButtonFlags & trigger << 1) != 0 : now - s.LastMotionTime > options_.StrokeGapTime))
+                End(e.Device, s, trigger ? now : s.LastMotionTime, emit);
+
+            const bool moved = !e.LastXYIsAbsolute() && (e.LastX() || e.LastY());
+            const bool start = trigger ? (e.RawMouse.usButtonFlags & trigger) != 0 : moved;
+            if (!s.Active && start)
+            {
+                const uint32_t generation = s.TimerGeneration;
+                s = StrokeState{};
+                s.TimerGeneration = generation;
+                s.Active = true;
+                s.StartTime = now;
+                s.LastMotionTime = now;
+                AddPoint(s);
+                if (!trigger) timers_.Schedule(now + options_.StrokeGapTime, GapTimer{e.Device, s.TimerGeneration});
+            }
+
+            if (s.Active && moved)
+            {
+                s.X += static_cast<float>(e.LastX());
+                s.Y += static_cast<float>(e.LastY());
+                s.Length += std::hypot(static_cast<float>(e.LastX()), static_cast<float>(e.LastY()));
+                s.LastMotionTime = now;
+                if (std::hypot(s.X - s.Xs[s.Count - 1], s.Y - s.Ys[s.Count - 1]) >= s.Spacing)
+                    AddPoint(s);
+            }
+        }
+
+        /// Ends strokes paused for StrokeGapTime.
+        template <class TEmit>
+        void Advance(TIMESTAMP now, TEmit&& emit)
+        {
+            timers_.Advance(now, [&](const GapTimer& t, TIMESTAMP)
+            {
+                auto it = strokes_.find(t.Device);
+                if (it == strokes_.end()) return;
+
+                StrokeState& s = it->second;
+                if (!s.Active || s.TimerGeneration != t.Generation) return;
+
+                if (now - s.LastMotionTime > options_.StrokeGapTime)
+                    End(t.Device, s, s.LastMotionTime, emit);
+                else
+                    timers_.Schedule(s.LastMotionTime + options_.StrokeGapTime + 1, t);
+            });
+        }
+
+        void Remove(HANDLE device) { strokes_.erase(device); }
+    };
+
+    /// Assembles keystroke bursts of barcode scanners into text.
+    /// Keys of scanners are held in a per-device buffer until the burst ends (a pause of MaxInterKeyTime).
+    class BarcodeBurstAssembler final
+    {
+    public:
+        /// Translates a key to characters, as ToUnicode does.
+        using TranslateKey = int (WINAPI*)(UINT vkey, UINT scan_code, const BYTE* key_state, LPWSTR buffer, int buffer_size, UINT flags);
+
+    private:
+        static constexpr size_t kMaxKeys = BarcodeEvent::kMaxLength * 2;
+
+        struct ScannerState
+        {
+            bool Scanner{};
+            bool Designated{}; // by SetRawInputBarcodeScanner
+
+            // Detection: run of fast key presses of a non-scanner device
+            TIMESTAMP LastKeyDownTime{};
+            uint32_t FastKeyDownCount{};
+
+            // Keys of the burst
+            ARRAY<KeyboardEvent, kMaxKeys> Keys{};
+            uint32_t TimerGeneration{};
+        };
+
+        struct GapTimer
+        {
+            HANDLE Device;
+            uint32_t Generation;
+        };
+
+        BarcodeScannerOptions options_;
+        TranslateKey translate_;
+        std::unordered_map<HANDLE, std::unique_ptr<ScannerState>> states_{};
+        TimerWheel<GapTimer> timers_{10000};
+
+        ScannerState& StateOf(HANDLE device)
+        {
+            std::unique_ptr<ScannerState>& s = states_[device];
+            if (!s) s = std::make_unique<ScannerState>();
+            return *s;
+        }
+
+        /// Ends the burst: makes text of a long burst, or delivers the keys as they are.
+        template <class TEmit, class TPass>
+        void End(HANDLE device, ScannerState& s, TEmit&& emit, TPass&& pass)
+        {
+            s.TimerGeneration++;
+            if (s.Keys.empty()) return;
+
+            uint32_t key_down_count = 0;
+            for (const KeyboardEvent& k : s.Keys)
+                if (k.KeyIsDown()) key_down_count++;
+
+            if (key_down_count < options_.MinBurstLength)
+            {
+                for (const KeyboardEvent& k : s.Keys) pass(k);
+                s.Keys.clear();
+                return;
+            }
+
+            BarcodeEvent r{};
+            r.Device = device;
+            r.Timestamp = s.Keys.back().Timestamp;
+
+            std::array<BYTE, 256> key_state{};
+            for (const KeyboardEvent& k : s.Keys)
+            {
+                const uint16_t vkey = k.VirtualKeyCode();
+                if (vkey == 0xFF) continue;
+
+                if (vkey == VK_SHIFT || vkey == VK_CONTROL || vkey == VK_MENU)
+                {
+                    const KeyId id = k.KeyId();
+                    const uint16_t side = vkey == VK_SHIFT ? (id == KeyId::RightShift ? VK_RSHIFT : VK_LSHIFT)
+                                        : vkey == VK_CONTROL ? (id == KeyId::RightControl ? VK_RCONTROL : VK_LCONTROL)
+                                        : (id == KeyId::RightAlt ? VK_RMENU : VK_LMENU);
+                    key_state[side] = k.KeyIsDown() ? 0x80 : 0x00;
+                    key_state[vkey] = (key_state[VK_LSHIFT + (vkey - VK_SHIFT) * 2] | key_state[VK_RSHIFT + (vkey - VK_SHIFT) * 2]) & 0x80;
+                    continue;
+                }
+
+                if (!k.KeyIsDown()) continue;
+                if (vkey == VK_RETURN)
+                {
+                    r.Terminated = true;
+                    continue;
+                }
+
+                std::array<wchar_t, 8> chars{};
+                const int n = translate_(vkey, k.RawKeyboard.MakeCode, key_state.data(), chars.data(), static_cast<int>(chars.size()), 0x4 /* keeps keyboard state */);
+                for (int i = 0; i < n && r.Length < r.Text.size(); i++)
+                    r.Text[r.Length++] = chars[i];
+            }
+
+            s.Keys.clear();
+            emit(r);
+        }
+
+    public:
+        explicit BarcodeBurstAssembler(BarcodeScannerOptions options, TranslateKey translate = ::ToUnicode) : options_(options), translate_(translate) { }
+
+        [[nodiscard]] bool HasPendingTimers() const { return !timers_.Empty(); }
+
+        /// @returns false: the key is not held, and to be delivered by the caller
+        template <class TEmit, class TPass>
+        bool Feed(const KeyboardEvent& e, TIMESTAMP now, TEmit&& emit, TPass&& pass)
+        {
+            ScannerState& s = StateOf(e.Device);
+
+            if (!s.Scanner)
+            {
+                if (!options_.AutoDetect || !e.KeyIsDown()) return false;
+
+                // A burst has ended: the device is a scanner from this key.
+                const bool fast = now - s.LastKeyDownTime <= options_.MaxInterKeyTime;
+                if (!fast && s.FastKeyDownCount >= options_.MinBurstLength)
+                {
+                    s.Scanner = true;
+                }
+                else
+                {
+                    s.FastKeyDownCount = fast ? s.FastKeyDownCount + 1 : 1;
+                    s.LastKeyDownTime = now;
+                    return false;
+                }
+            }
+
+            if (!s.Keys.empty() && now - s.Keys.back().Timestamp > options_.MaxInterKeyTime) End(e.Device, s, emit, pass);
+            if (s.Keys.size() == s.Keys.capacity()) End(e.Device, s, emit, pass);
+
+            if (s.Keys.empty()) timers_.Schedule(now + options_.MaxInterKeyTime + 1, GapTimer{e.Device, s.TimerGeneration});
+            s.Keys.push_back(e);
+            return true;
+        }
+
+        /// Ends bursts paused for MaxInterKeyTime.
+        template <class TEmit, class TPass>
+        void Advance(TIMESTAMP now, TEmit&& emit, TPass&& pass)
+        {
+            timers_.Advance(now, [&](const GapTimer& t, TIMESTAMP)
+            {
+                auto it = states_.find(t.Device);
+                if (it == states_.end()) return;
+
+                ScannerState& s = *it->second;
+                if (s.TimerGeneration != t.Generation || s.Keys.empty()) return;
+
+                if (now - s.Keys.back().Timestamp > options_.MaxInterKeyTime)
+                    End(t.Device, s, emit, pass);
+                else
+                    timers_.Schedule(s.Keys.back().Timestamp + options_.MaxInterKeyTime + 1, t);
+            });
+        }
+
+        /// Marks or unmarks a scanner. Held keys of an unmarked device are delivered.
+        template <class TPass>
+        void Designate(HANDLE device, bool scanner, TPass&& pass)
+        {
+            ScannerState& s = StateOf(device);
+            s.Designated = scanner;
+            s.Scanner = scanner;
+            s.FastKeyDownCount = 0;
+            if (!scanner)
+            {
+                for (const KeyboardEvent& k : s.Keys) pass(k);
+                s.Keys.clear();
+                s.TimerGeneration++;
+            }
+        }
+
+        /// Forgets a removed device. Held keys are delivered as they are.
+        template <class TPass>
+        void Remove(HANDLE device, TPass&& pass)
+        {
+            auto it = states_.find(device);
+            if (it == states_.end()) return;
+
+            for (const KeyboardEvent& k : it->second->Keys) pass(k);
+            states_.erase(it);
+        }
+    };
+
+    /// Contacts decoded from a digitizer report.
+    struct TouchReport
+    {
+        std::optional<uint32_t> ContactCount{}; // set in the first report of a frame
+        uint32_t ScanTime{};
+        ARRAY<std::pair<TouchContact, bool /* tip */>, TouchEvent::kMaxCountOfContacts> Contacts{};
+    };
+
+    /// Assembles touch frames from reports, and tracks contacts across frames.
+    /// Tracked contacts are stored in SoA: matching contact ids scans ids only.
+    class TouchContactTracker final
+    {
+        static inline constexpr size_t kCapacity = TouchEvent::kMaxCountOfContacts;
+
+        // tracked contacts
+        std::array<uint32_t, kCapacity> ids_{};
+        std::array<float, kCapacity> x_{};
+        std::array<float, kCapacity> y_{};
+        std::array<TIMESTAMP, kCapacity> down_time_{};
+        size_t count_{};
+
+        // frame in assembly
+        TouchReport pending_{};
+        uint32_t expected_{};
+
+        size_t Find(uint32_t id) const
+        {
+            for (size_t i = 0; i < count_; i++)
+                if (ids_[i] == id)
+                    return i;
+            return kCapacity;
+        }
+
+        /// Removes a contact by moving the last one into its slot.
+        void Remove(size_t i, uint32_t& seen)
+        {
+            count_--;
+            ids_[i] = ids_[count_];
+            x_[i] = x_[count_];
+            y_[i] = y_[count_];
+            down_time_[i] = down_time_[count_];
+            seen = (seen & ~(1u << i) & ~(1u << count_)) | (seen >> count_ & 1u) << i;
+        }
+
+        template <class TEmit>
+        void Complete(HANDLE device, TIMESTAMP now, TEmit&& emit)
+        {
+            // A frame cut short by a lost continuation report does not tell which contacts are lifted.
+            const bool complete = pending_.Contacts.size() >= std::min<size_t>(expected_, kCapacity);
+
+            TouchEvent e{device, now, pending_.ScanTime, {}};
+            uint32_t seen = 0; // by slot
+
+            for (auto [contact, tip] : pending_.Contacts)
+            {
+                size_t i = Find(contact.ContactId);
+                if (!tip)
+                {
+                    if (i == kCapacity) continue; // unknown contact
+                    contact.Phase = TouchContactPhase::Up;
+                    contact.DownTimestamp = down_time_[i];
+                    Remove(i, seen);
+                    e.Contacts.push_back(contact);
+                    continue;
+                }
+
+                if (i == kCapacity)
+                {
+                    if (count_ == kCapacity) continue; // too many contacts
+                    i = count_++;
+                    ids_[i] = contact.ContactId;
+                    down_time_[i] = now;
+                    contact.Phase = TouchContactPhase::Down;
+                }
+                else
+                {
+                    contact.Phase = TouchContactPhase::Move;
+                }
+
+                x_[i] = contact.X;
+                y_[i] = contact.Y;
+                contact.DownTimestamp = down_time_[i];
+                seen |= 1u << i;
+                e.Contacts.push_back(contact);
+            }
+
+            // Contacts missing in a complete frame are lifted without notice.
+            for (size_t i = 0; complete && i < count_;)
+            {
+                if (seen >> i & 1u) { i++; continue; }
+                e.Contacts.push_back(TouchContact{ids_[i], TouchContactPhase::Up, x_[i], y_[i], 0.0f, 0.0f, 0.0f, down_time_[i]});
+                Remove(i, seen);
+            }
+
+            pending_ = {};
+            expected_ = 0;
+            if (!e.Contacts.empty()) emit(e);
+        }
+
+    public:
+        /// Feeds a report, and emits a TouchEvent when a frame is complete.
+        template <class TEmit>
+        void Feed(HANDLE device, TIMESTAMP now, const TouchReport& report, TEmit&& emit)
+        {
+            if (report.ContactCount && *report.ContactCount != 0)
+            {
+                // Incomplete frame is emitted as is.
+                if (!pending_.Contacts.empty()) Complete(device, now, emit);
+                pending_.ScanTime = report.ScanTime;
+                expected_ = *report.ContactCount;
+            }
+            else if (expected_ == 0 && !report.Contacts.empty())
+            {
+                // Continuation of a frame whose first report is lost: the next frame tells all contacts again.
+                // (A report without contacts is a frame of no contacts.)
+                return;
+            }
+
+            for (auto&& c : report.Contacts)
+                pending_.Contacts.push_back(c);
+
+            if (pending_.Contacts.size() >= std::min<size_t>(expected_, kCapacity))
+                Complete(device, now, emit);
+        }
+    };
+
+    /// Per-device IMU state: report interval estimation and orientation fusion.
+    class ImuTracker final
+    {
+        TIMESTAMP last_message_time_{};
+        TIMESTAMP last_sample_time_{};
+        double interval_{}; // estimated report interval in microseconds
+        std::array<float, 4> q_{1.0f, 0.0f, 0.0f, 0.0f};
+        std::array<float, 3> last_acceleration_{};
+
+        /// Madgwick IMU update (gyroscope and accelerometer, without magnetometer).
+        void UpdateMadgwick(const std::array<float, 3>& gyro_dps, const std::array<float, 3>& accel, float beta, float dt)
+        {
+            const float DEG2RAD = std::acos(-1.0f) / 180.0f;
+            const float gx = gyro_dps[0] * DEG2RAD, gy = gyro_dps[1] * DEG2RAD, gz = gyro_dps[2] * DEG2RAD;
+            const auto [q0, q1, q2, q3] = q_;
+
+            // rate of change from gyroscope: q * (0, g) / 2
+            std::array<float, 4> q_dot{
+                0.5f * (-q1 * gx - q2 * gy - q3 * gz),
+                0.5f * (q0 * gx + q2 * gz - q3 * gy),
+                0.5f * (q0 * gy - q1 * gz + q3 * gx),
+                0.5f * (q0 * gz + q1 * gy - q2 * gx),
+            };
+
+            // gradient descent correction toward gravity
+            if (const float norm = std::sqrt(accel[0] * accel[0] + accel[1] * accel[1] + accel[2] * accel[2]); norm > 0.0f)
+            {
+                const float ax = accel[0] / norm, ay = accel[1] / norm, az = accel[2] / norm;
+                const float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+
+                std::array<float, 4> step{
+                    4.0f * q0 * q2q2 + 2.0f * q2 * ax + 4.0f * q0 * q1q1 - 2.0f * q1 * ay,
+                    4.0f * q1 * q3q3 - 2.0f * q3 * ax + 4.0f * q0q0 * q1 - 2.0f * q0 * ay - 4.0f * q1 + 8.0f * q1 * q1q1 + 8.0f * q1 * q2q2 + 4.0f * q1 * az,
+                    4.0f * q0q0 * q2 + 2.0f * q0 * ax + 4.0f * q2 * q3q3 - 2.0f * q3 * ay - 4.0f * q2 + 8.0f * q2 * q1q1 + 8.0f * q2 * q2q2 + 4.0f * q2 * az,
+                    4.0f * q1q1 * q3 - 2.0f * q1 * ax + 4.0f * q2q2 * q3 - 2.0f * q2 * ay,
+                };
+
+                float step_norm = 0.0f;
+                for (size_t i = 0; i < 4; i++) step_norm += step[i] * step[i];
+                if (step_norm > 0.0f)
+                {
+                    const float k = beta / std::sqrt(step_norm);
+                    for (size_t i = 0; i < 4; i++) q_dot[i] -= step[i] * k;
+                }
+            }
+
+            float q_norm = 0.0f;
+            for (size_t i = 0; i < 4; i++) q_[i] += q_dot[i] * dt, q_norm += q_[i] * q_[i];
+            const float k = 1.0f / std::sqrt(q_norm);
+            for (size_t i = 0; i < 4; i++) q_[i] *= k;
+        }
+
+    public:
+        /// Spreads reports of a message back over the estimated report interval.
+        /// @returns timestamp of the i-th report of count
+        TIMESTAMP ReportTime(TIMESTAMP message_time, size_t i, size_t count)
+        {
+            if (i == 0)
+            {
+                // exponential moving average of the interval per report
+                if (last_message_time_ && message_time > last_message_time_)
+                {
+                    const double interval = static_cast<double>(message_time - last_message_time_) / static_cast<double>(count);
+                    interval_ = interval_ > 0 ? interval_ * 0.9 + std::min(interval, interval_ * 4.0) * 0.1 : interval;
+                }
+                last_message_time_ = message_time;
+            }
+
+            const TIMESTAMP t = message_time - static_cast<TIMESTAMP>(interval_ * static_cast<double>(count - 1 - i));
+            return std::max(t, last_sample_time_);
+        }
+
+        /// Fuses the sample, and fills its orientation.
+        void Update(ImuEvent& e, ImuOrientationFilter filter, float gain)
+        {
+            const float dt = last_sample_time_ ? static_cast<float>(std::min<TIMESTAMP>(e.Timestamp - last_sample_time_, 100000)) / 1000000.0f : 0.0f;
+            last_sample_time_ = e.Timestamp;
+            if (e.HasAcceleration) last_acceleration_ = e.Acceleration; // for reports carrying only one of the sensors
+
+            if (filter == ImuOrientationFilter::Madgwick && e.HasAngularVelocity)
+            {
+                UpdateMadgwick(e.AngularVelocity, last_acceleration_, gain, dt);
+            }
+
+            e.HasOrientation = filter != ImuOrientationFilter::None;
+            e.Orientation = q_;
+        }
+    };
+}
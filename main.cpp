@@ -14,16 +14,74 @@
 #include <thread>
 #include <algorithm>
 #include <future>
+#include <chrono>
+#include <string_view>
+#include <fstream>
+#include <cstdlib>
 
-int main()
+/// Latency harness: measures capture thread wake-up latency and CPU cost with busy polling off and on.
+/// Probes are posted at 5 to 11 ms intervals, so that the busy-poll loop is found spinning, yielding or blocking.
+static int RunLatencyHarness(int probe_count)
 {
     using namespace ttsuki::librawinput;
+    using namespace std;
+
+    cout << "Wake-up latency, " << probe_count << " probes each:" << endl;
+    cout << " mode       samples   min(us)   avg(us)   max(us)  spins  yields  blocking   cpu(%)" << endl;
+    for (bool busy_poll : {false, true})
+    {
+        RawInputListenerOptions options{};
+        options.CaptureThread.BusyPoll = busy_poll;
+        auto listener = StartRawInput(RawInputDeviceType::Keyboard, RawInputCallbacks{}, options);
+        if (!listener) return 1;
+
+        for (int i = 0; i < probe_count; i++)
+        {
+            this_thread::sleep_for(chrono::milliseconds(5 + i % 7));
+            ProbeRawInputWakeUpLatency(listener);
+        }
+        this_thread::sleep_for(chrono::milliseconds(100)); // for the last probe
+
+        const RawInputListenerStatistics stats = GetRawInputListenerStatistics(listener);
+        cout << " " << left << setw(9) << (busy_poll ? "busy-poll" : "blocking") << right
+            << setw(9) << stats.WakeUpLatencySampleCount
+            << setw(10) << stats.WakeUpLatencyMin
+            << setw(10) << setprecision(1) << fixed << stats.WakeUpLatencyAverage
+            << setw(10) << stats.WakeUpLatencyMax
+            << setw(7) << stats.SpinCount
+            << setw(8) << stats.YieldCount
+            << setw(10) << stats.BlockingWaitCount
+            << setw(9) << setprecision(2) << (stats.WallTime ? 100.0 * static_cast<double>(stats.CpuTime) / static_cast<double>(stats.WallTime) : 0.0)
+            << endl;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace ttsuki::librawinput;
+
+    RawInputListenerOptions options{};
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string_view(argv[i]) == "--busy-poll")
+            options.CaptureThread.BusyPoll = true;
+        if (std::string_view(argv[i]) == "--latency") // [probe count]
+        {
+            const int probe_count = i + 1 < argc ? std::atoi(argv[i + 1]) : 0;
+            return RunLatencyHarness(probe_count > 0 ? probe_count : 500);
+        }
+    }
 
     RawInputDeviceType targets{};
     targets |= RawInputDeviceType::Mouse;
     targets |= RawInputDeviceType::Keyboard;
     targets |= RawInputDeviceType::Joystick;
     targets |= RawInputDeviceType::GamePad;
+    targets |= RawInputDeviceType::Digitizer;
+    targets |= RawInputDeviceType::ConsumerControl;
+    targets |= RawInputDeviceType::MultiAxis;
 
     // Shows connected devices.
     {
@@ -50,11 +108,15 @@ int main()
                 case RawInputDeviceType::Keyboard: return "Keyboard";
                 case RawInputDeviceType::Joystick: return "Joystick";
                 case RawInputDeviceType::GamePad: return "GamePad";
+                case RawInputDeviceType::Digitizer: return "Digitizer";
+                case RawInputDeviceType::ConsumerControl: return "ConsumerControl";
+                case RawInputDeviceType::MultiAxis: return "MultiAxis";
                 case RawInputDeviceType::Other: return "Other";
                 case RawInputDeviceType::ALL: return "ALL";
                 default: return "?";
                 }
             }(device.Type);
+            if (device.VendorId || device.ProductId) cout << hex << setfill('0') << " VID=" << setw(4) << device.VendorId << " PID=" << setw(4) << device.ProductId << dec << setfill(' ');
             wcout << L" Path=" << (!device.Path.empty() ? device.Path : L"(empty)");
             if (!device.ManufactureName.empty()) wcout << L" ManufactureName=" << device.ManufactureName;
             if (!device.ProductName.empty()) wcout << L" ProductName=" << device.ProductName;
@@ -78,6 +140,7 @@ int main()
         oss << " Keyboard";
         oss << " device=" << "0x" << e.Device;
         oss << " vkey=" << hex << std::setw(2) << e.VirtualKeyCode() << dec;
+        oss << " key=" << hex << std::setw(2) << static_cast<uint32_t>(e.KeyId()) << dec;
         oss << " " << (e.KeyIsDown() ? "down" : "up");
         oss << "\n";
         cout << oss.str();
@@ -88,6 +151,18 @@ int main()
         }
     };
 
+    callbacks.BarcodeEventCallback = [](const BarcodeEvent& e)
+    {
+        using namespace std;
+        wostringstream oss;
+        oss << L" time=" << setprecision(6) << fixed << (static_cast<double>(e.Timestamp) / 1000000.0);
+        oss << L" Barcode";
+        oss << L" device=" << L"0x" << e.Device;
+        oss << L" text=\"" << e.View() << L"\"" << (e.Terminated ? L" (enter)" : L"");
+        oss << L"\n";
+        wcout << oss.str();
+    };
+
     callbacks.MouseEventCallback = [](const MouseEvent& e)
     {
         using namespace std;
@@ -97,7 +172,8 @@ int main()
         oss << " device=" << "0x" << e.Device;
         oss << " " << (e.LastXYIsAbsolute() ? "absolute" : "relative");
         oss << " position=" << e.LastX() << "," << e.LastY();
-        if (e.WheelDelta()) oss << " wheel=" << e.WheelDelta();
+        if (e.WheelDelta()) oss << " wheel=" << e.WheelDelta() << "(" << e.WheelNotches << ")";
+        if (e.HorizontalWheelDelta()) oss << " hwheel=" << e.HorizontalWheelDelta() << "(" << e.HorizontalWheelNotches << ")";
         oss << " buttons=";
         oss << (e.ButtonIsDown(MouseEvent::ButtonIndex::Button1) ? "1" : e.ButtonIsUp(MouseEvent::ButtonIndex::Button1) ? "x" : "_");
         oss << (e.ButtonIsDown(MouseEvent::ButtonIndex::Button2) ? "2" : e.ButtonIsUp(MouseEvent::ButtonIndex::Button2) ? "x" : "_");
@@ -108,6 +184,59 @@ int main()
         cout << oss.str();
     };
 
+    callbacks.MouseGestureEventCallback = [](const MouseGestureEvent& e)
+    {
+        using namespace std;
+        ostringstream oss;
+        oss << " time=" << setprecision(6) << fixed << (static_cast<double>(e.Timestamp) / 1000000.0);
+        oss << " MouseGesture";
+        oss << " device=" << "0x" << e.Device;
+        oss << " " << [](MouseGestureKind k)
+        {
+            switch (k)
+            {
+            case MouseGestureKind::Click: return "click";
+            case MouseGestureKind::DoubleClick: return "double-click";
+            case MouseGestureKind::SingleClick: return "single-click";
+            case MouseGestureKind::DragStart: return "drag-start";
+            case MouseGestureKind::DragEnd: return "drag-end";
+            default: return "?";
+            }
+        }(e.Kind);
+        oss << " button=" << hex << static_cast<uint32_t>(e.Button) << dec;
+        oss << " count=" << e.ClickCount;
+        oss << " position=" << e.X << "," << e.Y;
+        oss << "\n";
+        cout << oss.str();
+    };
+
+    callbacks.MouseStrokeEventCallback = [](const MouseStrokeEvent& e)
+    {
+        using namespace std;
+        ostringstream oss;
+        oss << " time=" << setprecision(6) << fixed << (static_cast<double>(e.Timestamp) / 1000000.0);
+        oss << " MouseStroke";
+        oss << " device=" << "0x" << e.Device;
+        oss << " " << [](MouseStrokeKind k)
+        {
+            switch (k)
+            {
+            case MouseStrokeKind::Stroke: return "stroke";
+            case MouseStrokeKind::Flick: return "flick";
+            case MouseStrokeKind::Circle: return "circle";
+            case MouseStrokeKind::Template: return "template";
+            default: return "?";
+            }
+        }(e.Kind);
+        if (e.Kind == MouseStrokeKind::Circle) oss << (e.Clockwise ? " clockwise" : " counterclockwise");
+        if (e.Kind == MouseStrokeKind::Template) oss << " id=" << e.TemplateId << " score=" << setprecision(2) << e.Score;
+        oss << " direction=" << setprecision(0) << (e.Direction * 180.0f / 3.14159265f) << "deg";
+        oss << " length=" << setprecision(0) << e.Length;
+        oss << " duration=" << e.Duration << "us";
+        oss << "\n";
+        cout << oss.str();
+    };
+
     callbacks.JoystickHidEventCallback = [](const JoystickHidEvent& e)
     {
         using namespace std;
@@ -117,20 +246,20 @@ int main()
         oss << " device=" << "0x" << e.Device;
 
         oss << setprecision(3) << fixed << showpos;
-        if (e.X) oss << " X=" << *e.X;
-        if (e.Y) oss << " Y=" << *e.Y;
-        if (e.Z) oss << " Z=" << *e.Z;
-        if (e.RotX) oss << " Rx=" << *e.RotX;
-        if (e.RotY) oss << " Ry=" << *e.RotY;
-        if (e.RotZ) oss << " Rz=" << *e.RotZ;
-        if (e.Slider0) oss << " S0=" << *e.Slider0;
-        if (e.Slider1) oss << " S1=" << *e.Slider1;
-        if (e.HatSwitch0) oss << " HS0=" << *e.HatSwitch0;
-        if (e.HatSwitch1) oss << " HS1=" << *e.HatSwitch1;
-        if (e.HatSwitch0X) oss << " HS0X=" << *e.HatSwitch0X;
-        if (e.HatSwitch0Y) oss << " HS0Y=" << *e.HatSwitch0Y;
-        if (e.HatSwitch1X) oss << " HS1X=" << *e.HatSwitch1X;
-        if (e.HatSwitch1Y) oss << " HS1Y=" << *e.HatSwitch1Y;
+        if (auto v = e.X()) oss << " X=" << *v;
+        if (auto v = e.Y()) oss << " Y=" << *v;
+        if (auto v = e.Z()) oss << " Z=" << *v;
+        if (auto v = e.RotX()) oss << " Rx=" << *v;
+        if (auto v = e.RotY()) oss << " Ry=" << *v;
+        if (auto v = e.RotZ()) oss << " Rz=" << *v;
+        if (auto v = e.Slider0()) oss << " S0=" << *v;
+        if (auto v = e.Slider1()) oss << " S1=" << *v;
+        if (auto v = e.HatSwitch0()) oss << " HS0=" << *v;
+        if (auto v = e.HatSwitch1()) oss << " HS1=" << *v;
+        if (auto v = e.HatSwitch0X()) oss << " HS0X=" << *v;
+        if (auto v = e.HatSwitch0Y()) oss << " HS0Y=" << *v;
+        if (auto v = e.HatSwitch1X()) oss << " HS1X=" << *v;
+        if (auto v = e.HatSwitch1Y()) oss << " HS1Y=" << *v;
 
         auto btn = e.Buttons.to_string('_', '1');
         std::reverse(btn.begin(), btn.end());
@@ -140,6 +269,98 @@ int main()
         cout << oss.str();
     };
 
+    callbacks.TouchEventCallback = [](const TouchEvent& e)
+    {
+        using namespace std;
+        ostringstream oss;
+        oss << " time=" << setprecision(6) << fixed << (static_cast<double>(e.Timestamp) / 1000000.0);
+        oss << " Touch";
+        oss << " device=" << "0x" << e.Device;
+        oss << " scan=" << e.ScanTime;
+        oss << setprecision(3) << fixed;
+        for (auto&& c : e.Contacts)
+        {
+            oss << " [" << c.ContactId;
+            oss << " " << (c.Phase == TouchContactPhase::Down ? "down" : c.Phase == TouchContactPhase::Up ? "up" : "move");
+            oss << " " << c.X << "," << c.Y;
+            if (c.Pressure) oss << " p=" << c.Pressure;
+            oss << "]";
+        }
+        oss << "\n";
+        cout << oss.str();
+    };
+
+    callbacks.PenEventBatchCallback = [](const PenEvent* events, size_t count)
+    {
+        using namespace std;
+        const PenEvent& e = events[count - 1];
+        ostringstream oss;
+        oss << " time=" << setprecision(6) << fixed << (static_cast<double>(e.Timestamp) / 1000000.0);
+        oss << " Pen";
+        oss << " device=" << "0x" << e.Device;
+        oss << " samples=" << count;
+        oss << setprecision(3) << fixed;
+        oss << " " << (e.Tip ? "tip" : e.InRange ? "hover" : "out");
+        oss << " position=" << e.X << "," << e.Y;
+        oss << " pressure=" << e.Pressure;
+        oss << " tilt=" << e.TiltX << "," << e.TiltY;
+        if (e.Barrel) oss << " barrel";
+        if (e.Eraser || e.Invert) oss << " eraser";
+        oss << "\n";
+        cout << oss.str();
+    };
+
+    callbacks.ConsumerControlEventCallback = [](const ConsumerControlEvent& e)
+    {
+        using namespace std;
+        ostringstream oss;
+        oss << " time=" << setprecision(6) << fixed << (static_cast<double>(e.Timestamp) / 1000000.0);
+        oss << " ConsumerControl";
+        oss << " device=" << "0x" << e.Device;
+        oss << " pressed=";
+        for (uint16_t u : e.Pressed) oss << hex << setw(4) << setfill('0') << u << dec << " ";
+        for (auto&& enc : e.Encoders) oss << " encoder(" << hex << setw(4) << setfill('0') << enc.Usage << dec << ")=" << showpos << enc.Delta << noshowpos;
+        oss << "\n";
+        cout << oss.str();
+    };
+
+    callbacks.MultiAxisEventCallback = [](const MultiAxisEvent& e)
+    {
+        using namespace std;
+        ostringstream oss;
+        oss << " time=" << setprecision(6) << fixed << (static_cast<double>(e.Timestamp) / 1000000.0);
+        oss << " MultiAxis";
+        oss << " device=" << "0x" << e.Device;
+        oss << setprecision(3) << fixed << showpos;
+        oss << " T=" << e.Translation[0] << "," << e.Translation[1] << "," << e.Translation[2];
+        oss << " R=" << e.Rotation[0] << "," << e.Rotation[1] << "," << e.Rotation[2];
+        oss << noshowpos;
+        auto btn = e.Buttons.to_string('_', '1');
+        std::reverse(btn.begin(), btn.end());
+        oss << " Buttons(count=" << e.ButtonCount << ")=" << btn.substr(0, e.ButtonCount);
+        oss << "\n";
+        cout << oss.str();
+    };
+
+    callbacks.StandardGamepadEventCallback = [](const StandardGamepadEvent& e)
+    {
+        using namespace std;
+        ostringstream oss;
+        oss << " time=" << setprecision(6) << fixed << (static_cast<double>(e.Timestamp) / 1000000.0);
+        oss << " StandardGamepad";
+        oss << " device=" << "0x" << e.Device;
+        oss << setprecision(3) << fixed << showpos;
+        oss << " L=" << e.Axis(StandardGamepadAxis::LeftX) << "," << e.Axis(StandardGamepadAxis::LeftY);
+        oss << " R=" << e.Axis(StandardGamepadAxis::RightX) << "," << e.Axis(StandardGamepadAxis::RightY);
+        oss << " LT=" << e.Axis(StandardGamepadAxis::LeftTrigger) << " RT=" << e.Axis(StandardGamepadAxis::RightTrigger);
+        oss << noshowpos;
+        auto btn = std::bitset<kStandardGamepadButtonCount>(e.Buttons).to_string('_', '1');
+        std::reverse(btn.begin(), btn.end());
+        oss << " Buttons=" << btn;
+        oss << "\n";
+        cout << oss.str();
+    };
+
     callbacks.RawInputEventCallback = [](const RAWINPUT* raw, TIMESTAMP timestamp)
     {
         using namespace std;
@@ -206,10 +427,43 @@ int main()
     // Starts listening Raw Input events.
 
     std::cout << "Initializing RawInput event sink..." << std::endl;
-    auto rawInputListener = StartRawInput(targets, callbacks);
+    auto rawInputListener = StartRawInput(targets, callbacks, options);
+    if (std::ifstream db("gamecontrollerdb.txt"); db)
+    {
+        const std::string text((std::istreambuf_iterator<char>(db)), std::istreambuf_iterator<char>());
+        std::cout << "Loaded " << LoadRawInputGamepadMappings(rawInputListener, text) << " gamepad mappings." << std::endl;
+    }
+
     std::cout << "Ready. Press ESCAPE to exit." << std::endl;
 
-    escape_key_pressed.wait();
+    // Measures capture thread wake-up latency while waiting.
+    while (escape_key_pressed.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready)
+    {
+        ProbeRawInputWakeUpLatency(rawInputListener);
+    }
+
+    {
+        using namespace std;
+        const RawInputListenerStatistics stats = GetRawInputListenerStatistics(rawInputListener);
+        cout << "Capture thread statistics (" << (options.CaptureThread.BusyPoll ? "busy poll" : "blocking") << "):" << endl;
+        cout << " - inputs=" << stats.InputCount << " spins=" << stats.SpinCount << " yields=" << stats.YieldCount << " blocking_waits=" << stats.BlockingWaitCount << endl;
+        cout << " - cpu=" << stats.CpuTime << "us wall=" << stats.WallTime << "us"
+            << " (" << setprecision(2) << fixed << (stats.WallTime ? 100.0 * static_cast<double>(stats.CpuTime) / static_cast<double>(stats.WallTime) : 0.0) << "%)" << endl;
+        cout << " - wake-up latency: samples=" << stats.WakeUpLatencySampleCount
+            << " min=" << stats.WakeUpLatencyMin << "us"
+            << " avg=" << setprecision(1) << fixed << stats.WakeUpLatencyAverage << "us"
+            << " max=" << stats.WakeUpLatencyMax << "us" << endl;
+    }
+
+    for (auto&& keyboard : GetRawInputDeviceList(RawInputDeviceType::Keyboard))
+    {
+        using namespace std;
+        const RawInputKeyboardStatistics stats = GetRawInputKeyboardStatistics(rawInputListener, keyboard.Handle);
+        if (!stats.KeyDownCount) continue;
+        cout << "Keyboard 0x" << keyboard.Handle << ":"
+            << " keys=" << stats.KeyDownCount << " max_rollover=" << stats.MaxRollover
+            << " impossible_releases=" << stats.ImpossibleReleaseCount << " overruns=" << stats.OverrunCount << endl;
+    }
 
     std::cout << "Finalizing..." << std::endl;
     rawInputListener.reset();
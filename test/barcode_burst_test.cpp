@@ -0,0 +1,286 @@
+/// @file
+/// @brief  BarcodeBurstAssembler tests with injected bursts and a virtual clock.
+/// @author ttsuki
+
+// Licensed under the MIT License.
+// Copyright (c) 2019-2023 ttsuki All rights reserved.
+
+#include "librawinput_internal.h"
+#include "test.h"
+
+#include <string>
+#include <vector>
+
+using namespace ttsuki::librawinput;
+
+namespace
+{
+    const HANDLE kDevice = reinterpret_cast<HANDLE>(1);
+    constexpr TIMESTAMP kMaxInterKeyTime = BarcodeScannerOptions{}.MaxInterKeyTime;
+
+    /// US layout for digits and letters, independent of the host.
+    int WINAPI TranslateUs(UINT vkey, UINT, const BYTE* key_state, LPWSTR buffer, int buffer_size, UINT)
+    {
+        const bool shift = (key_state[VK_SHIFT] & 0x80) != 0;
+        wchar_t c = 0;
+        if (vkey >= '0' && vkey <= '9') c = shift ? L")!@#$%^&*("[vkey - '0'] : static_cast<wchar_t>(vkey);
+        if (vkey >= 'A' && vkey <= 'Z') c = static_cast<wchar_t>(shift ? vkey : vkey - 'A' + 'a');
+        if (c == 0 || buffer_size < 1) return 0;
+        buffer[0] = c;
+        return 1;
+    }
+
+    uint16_t ScanCodeOf(uint16_t vkey)
+    {
+        if (vkey == VK_RETURN) return 0x1C;
+        if (vkey == VK_SHIFT) return 0x2A;
+        if (vkey == '0') return 0x0B;
+        if (vkey >= '1' && vkey <= '9') return static_cast<uint16_t>(0x02 + vkey - '1');
+        return static_cast<uint16_t>(0x10 + (vkey - 'A') % 0x20); // distinct, enough for the tests
+    }
+
+    /// Feeds keys and advances the assembler on a virtual clock, as the capture thread does.
+    class Fixture
+    {
+        BarcodeBurstAssembler assembler_;
+
+    public:
+        std::vector<BarcodeEvent> Barcodes{};
+        std::vector<KeyboardEvent> Keys{}; // delivered as KeyboardEvent: passed through, or released late
+        TIMESTAMP Now{};
+
+        explicit Fixture(BarcodeScannerOptions options = {}) : assembler_(options, TranslateUs) { }
+
+        void Designate(bool scanner)
+        {
+            assembler_.Designate(kDevice, scanner, [this](const KeyboardEvent& k) { Keys.push_back(k); });
+        }
+
+        void Remove()
+        {
+            assembler_.Remove(kDevice, [this](const KeyboardEvent& k) { Keys.push_back(k); });
+        }
+
+        /// @returns true if the key is held
+        bool Key(TIMESTAMP now, uint16_t vkey, bool down)
+        {
+            Advance(now);
+
+            KeyboardEvent e{};
+            e.Device = kDevice;
+            e.Timestamp = now;
+            e.RawKeyboard.MakeCode = ScanCodeOf(vkey);
+            e.RawKeyboard.Flags = down ? RI_KEY_MAKE : RI_KEY_BREAK;
+            e.RawKeyboard.VKey = vkey;
+
+            const bool held = assembler_.Feed(
+                e, now,
+                [this](const BarcodeEvent& b) { Barcodes.push_back(b); },
+                [this](const KeyboardEvent& k) { Keys.push_back(k); });
+            if (!held) Keys.push_back(e);
+            return held;
+        }
+
+        /// Types keys: each key is pressed and released 1 ms later, and the next key comes after the interval.
+        /// @returns count of held key events
+        size_t Type(TIMESTAMP start, TIMESTAMP interval, std::string_view vkeys)
+        {
+            size_t held = 0;
+            TIMESTAMP t = start;
+            for (char c : vkeys)
+            {
+                const auto vkey = static_cast<uint16_t>(c == '\n' ? VK_RETURN : c);
+                held += Key(t, vkey, true);
+                held += Key(t + 1000, vkey, false);
+                t += interval;
+            }
+            return held;
+        }
+
+        /// Advances the clock in steps of the stage timer (10 ms).
+        void Advance(TIMESTAMP to)
+        {
+            const auto emit = [this](const BarcodeEvent& b) { Barcodes.push_back(b); };
+            const auto pass = [this](const KeyboardEvent& k) { Keys.push_back(k); };
+            for (; Now < to; Now = std::min(Now + 10000, to))
+                assembler_.Advance(Now, emit, pass);
+            assembler_.Advance(to, emit, pass);
+            Now = to;
+        }
+
+        [[nodiscard]] bool HasPendingTimers() const { return assembler_.HasPendingTimers(); }
+    };
+
+    std::wstring TextOf(const BarcodeEvent& b) { return std::wstring(b.View()); }
+
+    void DesignatedScannerBurst()
+    {
+        Fixture f;
+        f.Designate(true);
+
+        CHECK(f.Type(1234, 3000, "4901234567894\n") == 28);
+        CHECK(f.Keys.empty());
+        CHECK(f.Barcodes.empty());
+
+        // Ends within a tick of the stage timer after the pause.
+        const TIMESTAMP last = 1234 + 13 * 3000 + 1000;
+        f.Advance(last + kMaxInterKeyTime);
+        CHECK(f.Barcodes.empty());
+        f.Advance(last + kMaxInterKeyTime + 10000 + 1);
+        CHECK(f.Barcodes.size() == 1);
+        CHECK(!f.Barcodes.empty() && TextOf(f.Barcodes[0]) == L"4901234567894");
+        CHECK(!f.Barcodes.empty() && f.Barcodes[0].Terminated);
+        CHECK(!f.Barcodes.empty() && f.Barcodes[0].Device == kDevice);
+        CHECK(f.Keys.empty());
+        CHECK(!f.HasPendingTimers());
+    }
+
+    void ShiftedText()
+    {
+        Fixture f;
+        f.Designate(true);
+
+        TIMESTAMP t = 5000;
+        f.Key(t += 2000, VK_SHIFT, true);
+        f.Type(t += 2000, 2000, "AB");
+        f.Key(t += 4000, VK_SHIFT, false);
+        f.Type(t += 2000, 2000, "CD12");
+        f.Advance(t + 100000);
+
+        CHECK(f.Barcodes.size() == 1);
+        CHECK(!f.Barcodes.empty() && TextOf(f.Barcodes[0]) == L"ABcd12");
+        CHECK(!f.Barcodes.empty() && !f.Barcodes[0].Terminated);
+    }
+
+    void BurstsSeparatedByPause()
+    {
+        Fixture f;
+        f.Designate(true);
+
+        f.Type(10000, 5000, "111111\n");
+        f.Type(10000 + 7 * 5000 + kMaxInterKeyTime + 5000, 5000, "222222\n");
+        f.Advance(1000000);
+
+        CHECK(f.Barcodes.size() == 2);
+        CHECK(f.Barcodes.size() == 2 && TextOf(f.Barcodes[0]) == L"111111" && TextOf(f.Barcodes[1]) == L"222222");
+    }
+
+    void TypingOnScannerIsPassedThrough()
+    {
+        // A person typing on a scanner with a keyboard wedge: keys come one by one, late but in order.
+        Fixture f;
+        f.Designate(true);
+
+        CHECK(f.Type(10000, 150000, "HELLO") == 10);
+        f.Advance(2000000);
+
+        CHECK(f.Barcodes.empty());
+        CHECK(f.Keys.size() == 10);
+        for (size_t i = 0; i < f.Keys.size(); i++)
+        {
+            CHECK(f.Keys[i].RawKeyboard.VKey == static_cast<USHORT>("HELLO"[i / 2]));
+            CHECK(f.Keys[i].KeyIsDown() == (i % 2 == 0));
+        }
+    }
+
+    void ShortBurstIsPassedThrough()
+    {
+        Fixture f;
+        f.Designate(true);
+
+        f.Type(10000, 3000, "12345"); // shorter than MinBurstLength
+        f.Advance(1000000);
+
+        CHECK(f.Barcodes.empty());
+        CHECK(f.Keys.size() == 10);
+    }
+
+    void AutoDetect()
+    {
+        Fixture f;
+
+        // The first burst reveals the scanner, and is delivered as it is.
+        CHECK(f.Type(10000, 3000, "1234567\n") == 0);
+        CHECK(f.Keys.size() == 16);
+        CHECK(f.Barcodes.empty());
+
+        // The next burst is held from its first key.
+        CHECK(f.Type(500000, 3000, "7654321\n") == 16);
+        f.Advance(1000000);
+        CHECK(f.Keys.size() == 16);
+        CHECK(f.Barcodes.size() == 1);
+        CHECK(!f.Barcodes.empty() && TextOf(f.Barcodes[0]) == L"7654321" && f.Barcodes[0].Terminated);
+    }
+
+    void AutoDetectIgnoresTyping()
+    {
+        // Fast typing, but pauses come before a burst gets long enough.
+        Fixture f;
+        TIMESTAMP t = 10000;
+        for (int word = 0; word < 20; word++, t += 200000)
+            CHECK(f.Type(t, 15000, "WORD") == 0);
+
+        f.Advance(t + 1000000);
+        CHECK(f.Barcodes.empty());
+        CHECK(f.Keys.size() == 20 * 8);
+    }
+
+    void AutoDetectDisabled()
+    {
+        BarcodeScannerOptions options{};
+        options.AutoDetect = false;
+        Fixture f(options);
+
+        CHECK(f.Type(10000, 3000, "1234567\n") == 0);
+        CHECK(f.Type(500000, 3000, "7654321\n") == 0);
+        f.Advance(1000000);
+        CHECK(f.Barcodes.empty());
+    }
+
+    void RemovalFlushesHeldKeys()
+    {
+        Fixture f;
+        f.Designate(true);
+
+        CHECK(f.Type(10000, 3000, "123") == 6);
+        CHECK(f.Keys.empty());
+
+        f.Remove();
+        CHECK(f.Keys.size() == 6);
+        CHECK(f.Keys.size() == 6 && f.Keys[0].RawKeyboard.VKey == '1' && f.Keys[5].RawKeyboard.VKey == '3');
+
+        // Timers of the removed device are ignored.
+        f.Advance(1000000);
+        CHECK(f.Keys.size() == 6);
+        CHECK(f.Barcodes.empty());
+    }
+
+    void UnmarkingFlushesHeldKeys()
+    {
+        Fixture f;
+        f.Designate(true);
+
+        CHECK(f.Type(10000, 3000, "1234567") == 14);
+        f.Designate(false);
+        CHECK(f.Keys.size() == 14);
+
+        f.Advance(1000000);
+        CHECK(f.Barcodes.empty());
+        CHECK(f.Keys.size() == 14);
+    }
+}
+
+int main()
+{
+    DesignatedScannerBurst();
+    ShiftedText();
+    BurstsSeparatedByPause();
+    TypingOnScannerIsPassedThrough();
+    ShortBurstIsPassedThrough();
+    AutoDetect();
+    AutoDetectIgnoresTyping();
+    AutoDetectDisabled();
+    RemovalFlushesHeldKeys();
+    UnmarkingFlushesHeldKeys();
+    return test::Result();
+}
@@ -0,0 +1,151 @@
+/// @file
+/// @brief  EpochDomain tests: pinning, reclamation and overflow readers.
+/// @author ttsuki
+
+// Licensed under the MIT License.
+// Copyright (c) 2019-2023 ttsuki All rights reserved.
+
+#include "librawinput_internal.h"
+#include "test.h"
+
+#include <memory>
+#include <vector>
+
+using namespace ttsuki::librawinput;
+
+namespace
+{
+    /// Counts live instances.
+    struct Tracked
+    {
+        int* Alive;
+        explicit Tracked(int* alive) : Alive(alive) { ++*Alive; }
+        ~Tracked() { --*Alive; }
+        Tracked(const Tracked&) = delete;
+        Tracked& operator=(const Tracked&) = delete;
+    };
+
+    using Domain = EpochDomain<Tracked>;
+
+    void RetiredWithoutReadersIsFreed()
+    {
+        int alive = 0;
+        Domain d;
+        d.Retire(std::make_unique<Tracked>(&alive));
+        CHECK(alive == 0);
+        CHECK(!d.HasRetired());
+
+        d.Retire(nullptr);
+        CHECK(!d.HasRetired());
+    }
+
+    void PinnedReaderHoldsRetired()
+    {
+        int alive = 0;
+        Domain d;
+        const size_t slot = d.Enter();
+        CHECK(slot < Domain::kMaxReaders);
+
+        d.Retire(std::make_unique<Tracked>(&alive));
+        d.Retire(std::make_unique<Tracked>(&alive));
+        d.Reclaim();
+        CHECK(alive == 2);
+        CHECK(d.HasRetired());
+
+        d.Leave(slot);
+        CHECK(alive == 2); // freed by the capture thread, not by the reader
+        d.Reclaim();
+        CHECK(alive == 0);
+        CHECK(!d.HasRetired());
+    }
+
+    void LaterReaderDoesNotHold()
+    {
+        // A reader entering after the removal cannot reference the removed object.
+        int alive = 0;
+        Domain d;
+        const size_t early = d.Enter();
+        d.Retire(std::make_unique<Tracked>(&alive));
+        const size_t late = d.Enter();
+        d.Retire(std::make_unique<Tracked>(&alive));
+        CHECK(alive == 2);
+
+        d.Leave(early);
+        d.Reclaim();
+        CHECK(alive == 1); // the second is held by the late reader
+
+        d.Leave(late);
+        d.Reclaim();
+        CHECK(alive == 0);
+    }
+
+    void SlotsAreReused()
+    {
+        Domain d;
+        for (int i = 0; i < 1000; i++)
+        {
+            const size_t slot = d.Enter();
+            CHECK(slot < Domain::kMaxReaders);
+            d.Leave(slot);
+        }
+    }
+
+    void OverflowReadersHoldAll()
+    {
+        int alive = 0;
+        Domain d;
+
+        std::vector<size_t> slots;
+        for (size_t i = 0; i < Domain::kMaxReaders; i++) slots.push_back(d.Enter());
+        for (size_t i = 0; i < slots.size(); i++) CHECK(slots[i] == i);
+
+        const size_t overflow1 = d.Enter();
+        const size_t overflow2 = d.Enter();
+        CHECK(overflow1 == Domain::kOverflowSlot);
+        CHECK(overflow2 == Domain::kOverflowSlot);
+
+        for (size_t slot : slots) d.Leave(slot);
+        d.Retire(std::make_unique<Tracked>(&alive));
+
+        // Overflow readers do not tell their epochs: even objects retired after they entered are held.
+        d.Reclaim();
+        CHECK(alive == 1);
+
+        d.Leave(overflow1);
+        d.Reclaim();
+        CHECK(alive == 1);
+
+        d.Leave(overflow2);
+        d.Reclaim();
+        CHECK(alive == 0);
+
+        // The slot table is usable again.
+        const size_t slot = d.Enter();
+        CHECK(slot < Domain::kMaxReaders);
+        d.Leave(slot);
+    }
+
+    void DestructionFreesRetired()
+    {
+        int alive = 0;
+        {
+            Domain d;
+            const size_t slot = d.Enter();
+            d.Retire(std::make_unique<Tracked>(&alive));
+            CHECK(alive == 1);
+            d.Leave(slot);
+        }
+        CHECK(alive == 0);
+    }
+}
+
+int main()
+{
+    RetiredWithoutReadersIsFreed();
+    PinnedReaderHoldsRetired();
+    LaterReaderDoesNotHold();
+    SlotsAreReused();
+    OverflowReadersHoldAll();
+    DestructionFreesRetired();
+    return test::Result();
+}
@@ -0,0 +1,183 @@
+/// @file
+/// @brief  ImuTracker tests with synthetic motion.
+/// @author ttsuki
+
+// Licensed under the MIT License.
+// Copyright (c) 2019-2023 ttsuki All rights reserved.
+
+#include "librawinput_internal.h"
+#include "test.h"
+
+#include <array>
+#include <cmath>
+
+using namespace ttsuki::librawinput;
+
+namespace
+{
+    const HANDLE kDevice = reinterpret_cast<HANDLE>(1);
+    constexpr float kPi = 3.14159265358979f;
+    const float kGain = RawInputListenerOptions{}.ImuFilterGain;
+
+    ImuEvent Sample(TIMESTAMP t, std::array<float, 3> accel, std::array<float, 3> gyro_dps)
+    {
+        ImuEvent e{};
+        e.Device = kDevice;
+        e.Timestamp = t;
+        e.HasAcceleration = true;
+        e.HasAngularVelocity = true;
+        e.Acceleration = accel;
+        e.AngularVelocity = gyro_dps;
+        return e;
+    }
+
+    /// Gravity direction in the sensor frame as expected from the orientation.
+    std::array<float, 3> GravityOf(const std::array<float, 4>& q)
+    {
+        const auto [q0, q1, q2, q3] = q;
+        return {
+            2.0f * (q1 * q3 - q0 * q2),
+            2.0f * (q0 * q1 + q2 * q3),
+            q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3,
+        };
+    }
+
+    bool Near(float a, float b, float tolerance) { return std::abs(a - b) <= tolerance; }
+
+    void LevelAndStill()
+    {
+        ImuTracker tracker;
+        ImuEvent e{};
+        for (TIMESTAMP t = 1000; t <= 2000000; t += 4000)
+            tracker.Update(e = Sample(t, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f}), ImuOrientationFilter::Madgwick, kGain);
+
+        CHECK(e.HasOrientation);
+        CHECK(Near(e.Orientation[0], 1.0f, 1e-4f));
+        CHECK(Near(e.Orientation[1], 0.0f, 1e-4f) && Near(e.Orientation[2], 0.0f, 1e-4f) && Near(e.Orientation[3], 0.0f, 1e-4f));
+    }
+
+    void YawIntegratesGyro()
+    {
+        // 90 deg/s about the gravity axis for 1 s: gravity does not correct yaw.
+        ImuTracker tracker;
+        ImuEvent e{};
+        for (TIMESTAMP t = 0; t <= 1000000; t += 4000)
+            tracker.Update(e = Sample(t, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 90.0f}), ImuOrientationFilter::Madgwick, kGain);
+
+        // First-order integration lags slightly behind.
+        const float half = kPi / 4.0f;
+        CHECK(Near(e.Orientation[0], std::cos(half), 5e-3f));
+        CHECK(Near(e.Orientation[3], std::sin(half), 5e-3f));
+        CHECK(Near(e.Orientation[1], 0.0f, 1e-4f) && Near(e.Orientation[2], 0.0f, 1e-4f));
+    }
+
+    void TiltConvergesToGravity()
+    {
+        // The pad lies tilted by 30 degrees without rotating: the filter pulls the orientation toward gravity.
+        const float tilt = kPi / 6.0f;
+        const std::array<float, 3> accel{0.0f, std::sin(tilt), std::cos(tilt)};
+
+        ImuTracker tracker;
+        ImuEvent e{};
+        for (TIMESTAMP t = 0; t <= 10000000; t += 4000)
+            tracker.Update(e = Sample(t, accel, {0.0f, 0.0f, 0.0f}), ImuOrientationFilter::Madgwick, kGain);
+
+        const auto g = GravityOf(e.Orientation);
+        CHECK(Near(g[0], accel[0], 0.01f));
+        CHECK(Near(g[1], accel[1], 0.01f));
+        CHECK(Near(g[2], accel[2], 0.01f));
+    }
+
+    void RollTracksGravity()
+    {
+        // Rolls about X at 45 deg/s for 2 s, with gravity rotating accordingly and a gyro bias of 1 deg/s.
+        ImuTracker tracker;
+        ImuEvent e{};
+        float angle = 0.0f;
+        for (TIMESTAMP t = 0; t <= 2000000; t += 4000)
+        {
+            angle = 45.0f * static_cast<float>(t) / 1000000.0f * kPi / 180.0f;
+            const std::array<float, 3> accel{0.0f, std::sin(angle), std::cos(angle)};
+            tracker.Update(e = Sample(t, accel, {46.0f, 0.0f, 0.0f}), ImuOrientationFilter::Madgwick, kGain);
+        }
+
+        const auto g = GravityOf(e.Orientation);
+        CHECK(Near(g[1], std::sin(angle), 0.05f));
+        CHECK(Near(g[2], std::cos(angle), 0.05f));
+        CHECK(Near(std::abs(e.Orientation[0]), std::cos(angle / 2.0f), 0.05f));
+    }
+
+    void OrientationStaysNormalized()
+    {
+        ImuTracker tracker;
+        ImuEvent e{};
+        for (TIMESTAMP t = 0; t <= 3000000; t += 1000)
+        {
+            const float s = static_cast<float>(t) / 1000000.0f;
+            tracker.Update(e = Sample(t, {0.3f * std::sin(s * 7.0f), 0.5f, 0.8f}, {200.0f * std::sin(s), -150.0f, 500.0f * std::cos(s * 3.0f)}), ImuOrientationFilter::Madgwick, kGain);
+            const auto& q = e.Orientation;
+            if (!Near(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3], 1.0f, 1e-4f))
+            {
+                CHECK(!"orientation is not a unit quaternion");
+                break;
+            }
+        }
+    }
+
+    void SamplesWithoutGyro()
+    {
+        // Accelerometer-only reports are kept for the next gyro report, and do not move the orientation.
+        ImuTracker tracker;
+        ImuEvent e = Sample(1000, {0.0f, 1.0f, 0.0f}, {});
+        e.HasAngularVelocity = false;
+        tracker.Update(e, ImuOrientationFilter::Madgwick, kGain);
+        CHECK(e.HasOrientation && e.Orientation[0] == 1.0f);
+
+        e = Sample(5000, {}, {0.0f, 0.0f, 0.0f});
+        e.HasAcceleration = false;
+        tracker.Update(e, ImuOrientationFilter::Madgwick, kGain);
+        CHECK(e.Orientation[1] > 0.0f); // pulled toward +Y gravity, rolling about +X
+    }
+
+    void NoFilter()
+    {
+        ImuTracker tracker;
+        ImuEvent e = Sample(1000, {0.0f, 0.0f, 1.0f}, {90.0f, 0.0f, 0.0f});
+        tracker.Update(e, ImuOrientationFilter::None, kGain);
+        e = Sample(5000, {0.0f, 0.0f, 1.0f}, {90.0f, 0.0f, 0.0f});
+        tracker.Update(e, ImuOrientationFilter::None, kGain);
+        CHECK(!e.HasOrientation);
+    }
+
+    void ReportTimesAreSpread()
+    {
+        // Two reports per message every 8 ms: reports are 4 ms apart.
+        ImuTracker tracker;
+        TIMESTAMP last = 0;
+        for (TIMESTAMP m = 8000; m <= 800000; m += 8000)
+        {
+            const TIMESTAMP t0 = tracker.ReportTime(m, 0, 2);
+            const TIMESTAMP t1 = tracker.ReportTime(m, 1, 2);
+            CHECK(t1 == m);
+            CHECK(t0 >= last && t0 <= t1);
+            if (m > 80000) CHECK(Near(static_cast<float>(t1 - t0), 4000.0f, 100.0f));
+
+            ImuEvent e = Sample(t1, {0.0f, 0.0f, 1.0f}, {});
+            tracker.Update(e, ImuOrientationFilter::None, kGain);
+            last = t1;
+        }
+    }
+}
+
+int main()
+{
+    LevelAndStill();
+    YawIntegratesGyro();
+    TiltConvergesToGravity();
+    RollTracksGravity();
+    OrientationStaysNormalized();
+    SamplesWithoutGyro();
+    NoFilter();
+    ReportTimesAreSpread();
+    return test::Result();
+}
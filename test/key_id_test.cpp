@@ -0,0 +1,92 @@
+/// @file
+/// @brief  ToKeyId tests.
+/// @author ttsuki
+
+// Licensed under the MIT License.
+// Copyright (c) 2019-2023 ttsuki All rights reserved.
+
+#include "librawinput.h"
+#include "test.h"
+
+using namespace ttsuki::librawinput;
+
+namespace
+{
+    constexpr uint16_t VK_FAKE = 0xFF; // fake keys, and the second part of Pause
+
+    // Plain keys
+    static_assert(ToKeyId(0x1E, RI_KEY_MAKE, 'A') == static_cast<KeyId>(0x1E));
+    static_assert(ToKeyId(0x1E, RI_KEY_BREAK, 'A') == static_cast<KeyId>(0x1E));
+    static_assert(ToKeyId(0x01, RI_KEY_MAKE, VK_ESCAPE) == KeyId::Escape);
+    static_assert(ToKeyId(0x1C, RI_KEY_MAKE, VK_RETURN) == KeyId::Enter);
+
+    // Left and right modifiers
+    static_assert(ToKeyId(0x2A, RI_KEY_MAKE, VK_SHIFT) == KeyId::LeftShift);
+    static_assert(ToKeyId(0x36, RI_KEY_MAKE, VK_SHIFT) == KeyId::RightShift);
+    static_assert(ToKeyId(0x1D, RI_KEY_MAKE, VK_CONTROL) == KeyId::LeftControl);
+    static_assert(ToKeyId(0x1D, RI_KEY_E0, VK_CONTROL) == KeyId::RightControl);
+    static_assert(ToKeyId(0x38, RI_KEY_MAKE, VK_MENU) == KeyId::LeftAlt);
+    static_assert(ToKeyId(0x38, RI_KEY_E0 | RI_KEY_BREAK, VK_MENU) == KeyId::RightAlt);
+
+    // E0 keys: navigation keys are apart from numpad keys
+    static_assert(ToKeyId(0x47, RI_KEY_MAKE, VK_NUMPAD7) == KeyId::Numpad7);
+    static_assert(ToKeyId(0x47, RI_KEY_E0, VK_HOME) == KeyId::Home);
+    static_assert(ToKeyId(0x1C, RI_KEY_E0, VK_RETURN) == KeyId::NumpadEnter);
+    static_assert(ToKeyId(0x35, RI_KEY_E0, VK_DIVIDE) == KeyId::NumpadDivide);
+    static_assert(ToKeyId(0x5B, RI_KEY_E0, VK_LWIN) == KeyId::LeftWindows);
+
+    // Pause: E1 1D 45 comes as E1 1D with VK_PAUSE, then 45 with the fake VKey.
+    static_assert(ToKeyId(0x1D, RI_KEY_E1, VK_PAUSE) == KeyId::Pause);
+    static_assert(ToKeyId(0x1D, RI_KEY_E1 | RI_KEY_BREAK, VK_PAUSE) == KeyId::Pause);
+    static_assert(ToKeyId(0x45, RI_KEY_MAKE, VK_FAKE) == KeyId::None);
+    static_assert(ToKeyId(0x45, RI_KEY_MAKE, VK_NUMLOCK) == KeyId::NumLock);
+    static_assert(ToKeyId(0x46, RI_KEY_E0, VK_CANCEL) == KeyId::Break);
+    static_assert(ToKeyId(0x2A, RI_KEY_E1, VK_PAUSE) == KeyId::None);
+
+    // Fake shifts around E0 navigation keys (E0 2A, E0 AA) carry VKey 0xFF.
+    static_assert(ToKeyId(0x2A, RI_KEY_E0, VK_FAKE) == KeyId::None);
+    static_assert(ToKeyId(0x2A, RI_KEY_E0 | RI_KEY_BREAK, VK_FAKE) == KeyId::None);
+    static_assert(ToKeyId(0x36, RI_KEY_E0, VK_FAKE) == KeyId::None);
+
+    // Overrun and out of scan set 1
+    static_assert(ToKeyId(KEYBOARD_OVERRUN_MAKE_CODE, RI_KEY_MAKE, 0) == KeyId::None);
+    static_assert(ToKeyId(KEYBOARD_OVERRUN_MAKE_CODE, RI_KEY_MAKE, VK_FAKE) == KeyId::None);
+    static_assert(ToKeyId(0x00, RI_KEY_MAKE, 'A') == KeyId::None);
+    static_assert(ToKeyId(0x80, RI_KEY_MAKE, 'A') == KeyId::None);
+
+    void KeyboardEventKeyId()
+    {
+        KeyboardEvent e{};
+        e.RawKeyboard.MakeCode = 0x48;
+        e.RawKeyboard.Flags = RI_KEY_E0 | RI_KEY_BREAK;
+        e.RawKeyboard.VKey = VK_UP;
+        CHECK(e.KeyId() == KeyId::Up);
+
+        e.RawKeyboard.Flags = RI_KEY_MAKE;
+        e.RawKeyboard.VKey = VK_NUMPAD8;
+        CHECK(e.KeyId() == KeyId::Numpad8);
+    }
+
+    void KeyIdsAreDistinct()
+    {
+        // Every make code maps to its own bit, with and without E0.
+        bool seen[kKeyIdCount]{};
+        for (uint16_t code = 0x01; code <= 0x7F; code++)
+        {
+            for (uint16_t flags : {static_cast<uint16_t>(RI_KEY_MAKE), static_cast<uint16_t>(RI_KEY_E0)})
+            {
+                const auto bit = static_cast<size_t>(ToKeyId(code, flags, 'A'));
+                CHECK(bit != 0 && bit < kKeyIdCount);
+                CHECK(!seen[bit]);
+                seen[bit] = true;
+            }
+        }
+    }
+}
+
+int main()
+{
+    KeyboardEventKeyId();
+    KeyIdsAreDistinct();
+    return test::Result();
+}
@@ -0,0 +1,138 @@
+/// @file
+/// @brief  KeyboardStateTracker tests with injected key streams.
+/// @author ttsuki
+
+// Licensed under the MIT License.
+// Copyright (c) 2019-2023 ttsuki All rights reserved.
+
+#include "librawinput_internal.h"
+#include "test.h"
+
+using namespace ttsuki::librawinput;
+
+namespace
+{
+    RAWKEYBOARD Key(uint16_t make_code, bool down, uint16_t flags = 0, uint16_t vkey = 'A')
+    {
+        RAWKEYBOARD k{};
+        k.MakeCode = make_code;
+        k.Flags = static_cast<USHORT>(flags | (down ? RI_KEY_MAKE : RI_KEY_BREAK));
+        k.VKey = vkey;
+        return k;
+    }
+
+    void Rollover()
+    {
+        KeyboardStateTracker t;
+        for (uint16_t code = 0x10; code < 0x16; code++) t.Feed(Key(code, true)); // Q W E R T Y
+        CHECK(t.Statistics.PressedKeyCount == 6);
+        CHECK(t.Statistics.MaxRollover == 6);
+        CHECK(t.Statistics.PressedKeys.test(0x10) && t.Statistics.PressedKeys.test(0x15));
+
+        t.Feed(Key(0x10, false));
+        t.Feed(Key(0x11, false));
+        CHECK(t.Statistics.PressedKeyCount == 4);
+        CHECK(t.Statistics.MaxRollover == 6);
+        CHECK(!t.Statistics.PressedKeys.test(0x10));
+
+        for (uint16_t code = 0x12; code < 0x16; code++) t.Feed(Key(code, false));
+        CHECK(t.Statistics.PressedKeyCount == 0);
+        CHECK(t.Statistics.PressedKeys.none());
+        CHECK(t.Statistics.KeyDownCount == 6);
+    }
+
+    void LeftAndRightAreDistinct()
+    {
+        KeyboardStateTracker t;
+        t.Feed(Key(0x1D, true, 0, VK_CONTROL));
+        t.Feed(Key(0x1D, true, RI_KEY_E0, VK_CONTROL));
+        CHECK(t.Statistics.PressedKeyCount == 2);
+        CHECK(t.Statistics.AutoRepeatCount == 0);
+
+        t.Feed(Key(0x1D, false, RI_KEY_E0, VK_CONTROL));
+        CHECK(t.Statistics.PressedKeys.test(static_cast<size_t>(KeyId::LeftControl)));
+        CHECK(!t.Statistics.PressedKeys.test(static_cast<size_t>(KeyId::RightControl)));
+    }
+
+    void AutoRepeat()
+    {
+        KeyboardStateTracker t;
+        t.Feed(Key(0x1E, true));
+        for (int i = 0; i < 10; i++) t.Feed(Key(0x1E, true));
+        t.Feed(Key(0x1E, false));
+
+        CHECK(t.Statistics.KeyDownCount == 1);
+        CHECK(t.Statistics.AutoRepeatCount == 10);
+        CHECK(t.Statistics.MaxRollover == 1);
+        CHECK(t.Statistics.ImpossibleReleaseCount == 0);
+    }
+
+    void ImpossibleRelease()
+    {
+        // A key held since before the listener started, or a dropped make.
+        KeyboardStateTracker t;
+        t.Feed(Key(0x2A, false, 0, VK_SHIFT));
+        CHECK(t.Statistics.ImpossibleReleaseCount == 1);
+        CHECK(t.Statistics.PressedKeyCount == 0);
+
+        t.Feed(Key(0x2A, true, 0, VK_SHIFT));
+        t.Feed(Key(0x2A, false, 0, VK_SHIFT));
+        t.Feed(Key(0x2A, false, 0, VK_SHIFT));
+        CHECK(t.Statistics.ImpossibleReleaseCount == 2);
+        CHECK(t.Statistics.KeyDownCount == 1);
+    }
+
+    void Overrun()
+    {
+        KeyboardStateTracker t;
+        for (uint16_t code = 0x10; code < 0x16; code++) t.Feed(Key(code, true));
+        t.Feed(Key(KEYBOARD_OVERRUN_MAKE_CODE, true, 0, 0xFF));
+        t.Feed(Key(KEYBOARD_OVERRUN_MAKE_CODE, false, 0, 0xFF));
+
+        CHECK(t.Statistics.OverrunCount == 2);
+        CHECK(t.Statistics.PressedKeyCount == 6);
+        CHECK(t.Statistics.KeyDownCount == 6);
+        CHECK(t.Statistics.ImpossibleReleaseCount == 0);
+    }
+
+    void FakeKeysAreIgnored()
+    {
+        // Navigation keys with NumLock on come wrapped in fake shifts (E0 2A ... E0 AA).
+        KeyboardStateTracker t;
+        t.Feed(Key(0x2A, true, RI_KEY_E0, 0xFF));
+        t.Feed(Key(0x47, true, RI_KEY_E0, VK_HOME));
+        t.Feed(Key(0x47, false, RI_KEY_E0, VK_HOME));
+        t.Feed(Key(0x2A, false, RI_KEY_E0, 0xFF));
+
+        CHECK(t.Statistics.KeyDownCount == 1);
+        CHECK(t.Statistics.ImpossibleReleaseCount == 0);
+        CHECK(t.Statistics.PressedKeys.none());
+    }
+
+    void Pause()
+    {
+        // E1 1D 45: the second part has the fake VKey.
+        KeyboardStateTracker t;
+        t.Feed(Key(0x1D, true, RI_KEY_E1, VK_PAUSE));
+        t.Feed(Key(0x45, true, 0, 0xFF));
+        CHECK(t.Statistics.PressedKeyCount == 1);
+        CHECK(t.Statistics.PressedKeys.test(static_cast<size_t>(KeyId::Pause)));
+
+        t.Feed(Key(0x1D, false, RI_KEY_E1, VK_PAUSE));
+        t.Feed(Key(0x45, false, 0, 0xFF));
+        CHECK(t.Statistics.PressedKeyCount == 0);
+        CHECK(t.Statistics.ImpossibleReleaseCount == 0);
+    }
+}
+
+int main()
+{
+    Rollover();
+    LeftAndRightAreDistinct();
+    AutoRepeat();
+    ImpossibleRelease();
+    Overrun();
+    FakeKeysAreIgnored();
+    Pause();
+    return test::Result();
+}
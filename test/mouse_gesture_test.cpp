@@ -0,0 +1,191 @@
+/// @file
+/// @brief  MouseGestureRecognizer tests with injected events and a virtual clock.
+/// @author ttsuki
+
+// Licensed under the MIT License.
+// Copyright (c) 2019-2023 ttsuki All rights reserved.
+
+#include "librawinput_internal.h"
+#include "test.h"
+
+#include <vector>
+
+using namespace ttsuki::librawinput;
+
+namespace
+{
+    const HANDLE kDevice = reinterpret_cast<HANDLE>(1);
+
+    /// Feeds events and advances the recognizer on a virtual clock, as the capture thread does.
+    class Fixture
+    {
+        MouseGestureRecognizer recognizer_{MouseGestureOptions{}};
+
+    public:
+        std::vector<MouseGestureEvent> Events{};
+        TIMESTAMP Now{};
+
+        void Input(TIMESTAMP now, int32_t dx, int32_t dy, USHORT button_flags = 0)
+        {
+            Advance(now);
+
+            MouseEvent e{};
+            e.Device = kDevice;
+            e.Timestamp = now;
+            e.RawMouse.usFlags = MOUSE_MOVE_RELATIVE;
+            e.RawMouse.usButtonFlags = button_flags;
+            e.RawMouse.lLastX = dx;
+            e.RawMouse.lLastY = dy;
+            recognizer_.Feed(e, now, [this](const MouseGestureEvent& g) { Events.push_back(g); });
+        }
+
+        /// Advances the clock in steps of the stage timer (10 ms) from an unaligned start.
+        void Advance(TIMESTAMP to)
+        {
+            for (; Now < to; Now = std::min(Now + 10000, to))
+                recognizer_.Advance(Now, [this](const MouseGestureEvent& g) { Events.push_back(g); });
+            recognizer_.Advance(to, [this](const MouseGestureEvent& g) { Events.push_back(g); });
+            Now = to;
+        }
+
+        [[nodiscard]] size_t Count(MouseGestureKind kind) const
+        {
+            size_t n = 0;
+            for (const auto& e : Events) n += e.Kind == kind;
+            return n;
+        }
+
+        [[nodiscard]] bool HasPendingTimers() const { return recognizer_.HasPendingTimers(); }
+    };
+
+    constexpr TIMESTAMP kDoubleClickTime = MouseGestureOptions{}.DoubleClickTime;
+
+    void Click()
+    {
+        Fixture f;
+        f.Input(1234, 0, 0, RI_MOUSE_LEFT_BUTTON_DOWN);
+        f.Input(51234, 0, 0, RI_MOUSE_LEFT_BUTTON_UP);
+        CHECK(f.Events.size() == 1);
+        CHECK(f.Events.size() == 1 && f.Events[0].Kind == MouseGestureKind::Click && f.Events[0].ClickCount == 1);
+        CHECK(f.Events.size() == 1 && f.Events[0].Button == MouseEvent::ButtonIndex::LeftButton);
+    }
+
+    void SingleClickAfterDoubleClickTime()
+    {
+        Fixture f;
+        const TIMESTAMP up = 57777; // deadline falls in the middle of a tick
+        f.Input(1234, 0, 0, RI_MOUSE_LEFT_BUTTON_DOWN);
+        f.Input(up, 0, 0, RI_MOUSE_LEFT_BUTTON_UP);
+
+        f.Advance(up + kDoubleClickTime - 1);
+        CHECK(f.Count(MouseGestureKind::SingleClick) == 0);
+
+        // Within a tick of the stage timer after the double-click time.
+        f.Advance(up + kDoubleClickTime + 10000);
+        CHECK(f.Count(MouseGestureKind::SingleClick) == 1);
+        CHECK(f.Events.back().Timestamp == up + kDoubleClickTime);
+        CHECK(!f.HasPendingTimers());
+    }
+
+    void SingleClickFromInputOnly()
+    {
+        // Mouse motion alone drives the recognizer forward, at 1 ms intervals.
+        Fixture f;
+        f.Input(3, 0, 0, RI_MOUSE_LEFT_BUTTON_DOWN);
+        f.Input(4003, 0, 0, RI_MOUSE_LEFT_BUTTON_UP);
+
+        TIMESTAMP fired_at = 0;
+        for (TIMESTAMP t = 4003; t < 4003 + kDoubleClickTime + 30000 && !fired_at; t += 1000)
+        {
+            f.Input(t, 0, 0);
+            if (f.Count(MouseGestureKind::SingleClick)) fired_at = t;
+        }
+
+        CHECK(fired_at >= 4003 + kDoubleClickTime);
+        CHECK(fired_at < 4003 + kDoubleClickTime + 10000 + 1000);
+    }
+
+    void DoubleClick()
+    {
+        Fixture f;
+        f.Input(10000, 0, 0, RI_MOUSE_LEFT_BUTTON_DOWN);
+        f.Input(60000, 0, 0, RI_MOUSE_LEFT_BUTTON_UP);
+        f.Input(250000, 1, 1, RI_MOUSE_LEFT_BUTTON_DOWN);
+        f.Input(300000, 0, 0, RI_MOUSE_LEFT_BUTTON_UP);
+        f.Advance(2000000);
+
+        CHECK(f.Events.size() == 3);
+        CHECK(f.Events.size() == 3 && f.Events[0].Kind == MouseGestureKind::Click && f.Events[0].ClickCount == 1);
+        CHECK(f.Events.size() == 3 && f.Events[1].Kind == MouseGestureKind::DoubleClick && f.Events[1].ClickCount == 2);
+        CHECK(f.Events.size() == 3 && f.Events[2].Kind == MouseGestureKind::Click && f.Events[2].ClickCount == 2);
+        CHECK(f.Count(MouseGestureKind::SingleClick) == 0);
+    }
+
+    void SlowSecondPressIsNotDoubleClick()
+    {
+        Fixture f;
+        f.Input(10000, 0, 0, RI_MOUSE_LEFT_BUTTON_DOWN);
+        f.Input(60000, 0, 0, RI_MOUSE_LEFT_BUTTON_UP);
+        f.Input(60000 + kDoubleClickTime + 1, 0, 0, RI_MOUSE_LEFT_BUTTON_DOWN);
+        f.Input(60000 + kDoubleClickTime + 50000, 0, 0, RI_MOUSE_LEFT_BUTTON_UP);
+
+        CHECK(f.Count(MouseGestureKind::DoubleClick) == 0);
+        CHECK(f.Count(MouseGestureKind::SingleClick) == 1);
+        CHECK(f.Count(MouseGestureKind::Click) == 2);
+        CHECK(f.Events.back().ClickCount == 1);
+    }
+
+    void FarSecondPressIsNotDoubleClick()
+    {
+        Fixture f;
+        f.Input(10000, 0, 0, RI_MOUSE_LEFT_BUTTON_DOWN);
+        f.Input(60000, 0, 0, RI_MOUSE_LEFT_BUTTON_UP);
+        f.Input(100000, 50, 0);
+        f.Input(150000, 0, 0, RI_MOUSE_LEFT_BUTTON_DOWN);
+
+        CHECK(f.Count(MouseGestureKind::DoubleClick) == 0);
+    }
+
+    void Drag()
+    {
+        Fixture f;
+        f.Input(10000, 0, 0, RI_MOUSE_LEFT_BUTTON_DOWN);
+        f.Input(20000, 2, 0);
+        CHECK(f.Events.empty()); // within the drag distance
+
+        f.Input(30000, 10, 5);
+        f.Input(40000, 0, 0, RI_MOUSE_LEFT_BUTTON_UP);
+        f.Advance(2000000);
+
+        CHECK(f.Events.size() == 2);
+        CHECK(f.Events.size() == 2 && f.Events[0].Kind == MouseGestureKind::DragStart && f.Events[0].X == 0 && f.Events[0].Y == 0);
+        CHECK(f.Events.size() == 2 && f.Events[1].Kind == MouseGestureKind::DragEnd && f.Events[1].X == 12 && f.Events[1].Y == 5);
+    }
+
+    void ButtonsAreIndependent()
+    {
+        Fixture f;
+        f.Input(10000, 0, 0, RI_MOUSE_LEFT_BUTTON_DOWN);
+        f.Input(20000, 0, 0, RI_MOUSE_RIGHT_BUTTON_DOWN);
+        f.Input(30000, 0, 0, RI_MOUSE_RIGHT_BUTTON_UP);
+        f.Input(40000, 0, 0, RI_MOUSE_LEFT_BUTTON_UP);
+        f.Advance(2000000);
+
+        CHECK(f.Count(MouseGestureKind::Click) == 2);
+        CHECK(f.Count(MouseGestureKind::SingleClick) == 2);
+        CHECK(f.Events.size() == 4 && f.Events[0].Button == MouseEvent::ButtonIndex::RightButton);
+    }
+}
+
+int main()
+{
+    Click();
+    SingleClickAfterDoubleClickTime();
+    SingleClickFromInputOnly();
+    DoubleClick();
+    SlowSecondPressIsNotDoubleClick();
+    FarSecondPressIsNotDoubleClick();
+    Drag();
+    ButtonsAreIndependent();
+    return test::Result();
+}
@@ -0,0 +1,228 @@
+/// @file
+/// @brief  MouseStrokeRecognizer tests with injected motion and a virtual clock.
+/// @author ttsuki
+
+// Licensed under the MIT License.
+// Copyright (c) 2019-2023 ttsuki All rights reserved.
+
+#include "librawinput_internal.h"
+#include "test.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace ttsuki::librawinput;
+
+namespace
+{
+    const HANDLE kDevice = reinterpret_cast<HANDLE>(1);
+    constexpr float kPi = 3.14159265358979f;
+
+    /// Feeds motion and advances the recognizer on a virtual clock, as the capture thread does.
+    class Fixture
+    {
+        MouseStrokeRecognizer recognizer_;
+        float x_{}; // position drawn so far, rounded to device units on input
+        float y_{};
+        int32_t ix_{};
+        int32_t iy_{};
+
+    public:
+        std::vector<MouseStrokeEvent> Events{};
+        TIMESTAMP Now{};
+
+        explicit Fixture(MouseStrokeOptions options = {}) : recognizer_(std::move(options)) { }
+
+        void Input(TIMESTAMP now, int32_t dx, int32_t dy, USHORT button_flags = 0)
+        {
+            Advance(now);
+
+            MouseEvent e{};
+            e.Device = kDevice;
+            e.Timestamp = now;
+            e.RawMouse.usFlags = MOUSE_MOVE_RELATIVE;
+            e.RawMouse.usButtonFlags = button_flags;
+            e.RawMouse.lLastX = dx;
+            e.RawMouse.lLastY = dy;
+            recognizer_.Feed(e, now, [this](const MouseStrokeEvent& s) { Events.push_back(s); });
+        }
+
+        /// Moves to an absolute position of the drawing, as integer deltas.
+        void MoveTo(TIMESTAMP now, float x, float y)
+        {
+            x_ = x, y_ = y;
+            const auto nx = static_cast<int32_t>(std::lround(x_));
+            const auto ny = static_cast<int32_t>(std::lround(y_));
+            Input(now, nx - ix_, ny - iy_);
+            ix_ = nx, iy_ = ny;
+        }
+
+        /// Advances the clock in steps of the stage timer (10 ms).
+        void Advance(TIMESTAMP to)
+        {
+            for (; Now < to; Now = std::min(Now + 10000, to))
+                recognizer_.Advance(Now, [this](const MouseStrokeEvent& s) { Events.push_back(s); });
+            recognizer_.Advance(to, [this](const MouseStrokeEvent& s) { Events.push_back(s); });
+            Now = to;
+        }
+
+        [[nodiscard]] bool HasPendingTimers() const { return recognizer_.HasPendingTimers(); }
+    };
+
+    MouseStrokeOptions NoTrigger()
+    {
+        MouseStrokeOptions options{};
+        options.TriggerButton = 0;
+        return options;
+    }
+
+    void Flick()
+    {
+        Fixture f;
+        f.Input(10000, 0, 0, RI_MOUSE_RIGHT_BUTTON_DOWN);
+        for (int i = 1; i <= 10; i++) f.Input(10000 + i * 5000, 20, 0);
+        f.Input(65000, 0, 0, RI_MOUSE_RIGHT_BUTTON_UP);
+
+        CHECK(f.Events.size() == 1);
+        CHECK(!f.Events.empty() && f.Events[0].Kind == MouseStrokeKind::Flick);
+        CHECK(!f.Events.empty() && f.Events[0].Length == 200.0f);
+        CHECK(!f.Events.empty() && std::abs(f.Events[0].Direction) < 0.01f);
+        CHECK(!f.Events.empty() && f.Events[0].Duration == 55000);
+    }
+
+    void SlowStroke()
+    {
+        Fixture f;
+        f.Input(10000, 0, 0, RI_MOUSE_RIGHT_BUTTON_DOWN);
+        for (int i = 1; i <= 50; i++) f.Input(10000 + i * 10000, 0, 4); // down, 400/s
+        f.Input(520000, 0, 0, RI_MOUSE_RIGHT_BUTTON_UP);
+
+        CHECK(f.Events.size() == 1);
+        CHECK(!f.Events.empty() && f.Events[0].Kind == MouseStrokeKind::Stroke);
+        CHECK(!f.Events.empty() && std::abs(f.Events[0].Direction - kPi / 2) < 0.01f);
+    }
+
+    void ShortStrokeIsIgnored()
+    {
+        Fixture f;
+        f.Input(10000, 0, 0, RI_MOUSE_RIGHT_BUTTON_DOWN);
+        f.Input(15000, 10, 0);
+        f.Input(20000, 0, 0, RI_MOUSE_RIGHT_BUTTON_UP);
+        f.Advance(1000000);
+
+        CHECK(f.Events.empty());
+    }
+
+    void MotionWithoutTriggerIsIgnored()
+    {
+        Fixture f;
+        for (int i = 1; i <= 20; i++) f.Input(i * 5000, 20, 0);
+        f.Advance(1000000);
+
+        CHECK(f.Events.empty());
+    }
+
+    void Circle(bool clockwise)
+    {
+        Fixture f(NoTrigger());
+        const float sign = clockwise ? 1.0f : -1.0f;
+        TIMESTAMP t = 12345;
+        for (int i = 0; i <= 64; i++, t += 4000)
+        {
+            const float a = sign * 2.0f * kPi * static_cast<float>(i) / 64.0f;
+            f.MoveTo(t, 100.0f * std::sin(a), 100.0f - 100.0f * std::cos(a)); // from the top, +Y down
+        }
+        f.Advance(t + 1000000);
+
+        CHECK(f.Events.size() == 1);
+        CHECK(!f.Events.empty() && f.Events[0].Kind == MouseStrokeKind::Circle);
+        CHECK(!f.Events.empty() && f.Events[0].Clockwise == clockwise);
+    }
+
+    void GapEndsStroke()
+    {
+        // Ended by the stage timer within a tick after the pause, deadline in the middle of a tick.
+        const MouseStrokeOptions options = NoTrigger();
+        Fixture f(options);
+        TIMESTAMP t = 3333;
+        for (int i = 0; i < 30; i++, t += 2000) f.Input(t, 10, 0);
+        const TIMESTAMP last = t - 2000;
+
+        f.Advance(last + options.StrokeGapTime);
+        CHECK(f.Events.empty());
+
+        f.Advance(last + options.StrokeGapTime + 10000 + 1);
+        CHECK(f.Events.size() == 1);
+        CHECK(!f.Events.empty() && f.Events[0].Timestamp == last);
+        CHECK(!f.Events.empty() && f.Events[0].Length == 300.0f);
+        CHECK(!f.HasPendingTimers());
+    }
+
+    void GapSeparatesStrokes()
+    {
+        // The next motion after a pause ends the stroke, even if the timer has not come yet.
+        const MouseStrokeOptions options = NoTrigger();
+        Fixture f(options);
+        for (int i = 0; i < 10; i++) f.Input(10000 + i * 1000, 10, 0);
+        f.Input(19000 + options.StrokeGapTime + 1, 0, 10);
+        CHECK(f.Events.size() == 1);
+        CHECK(!f.Events.empty() && f.Events[0].Timestamp == 19000);
+
+        for (int i = 1; i < 10; i++) f.Input(19000 + options.StrokeGapTime + 1 + i * 1000, 0, 10);
+        f.Advance(1000000);
+        CHECK(f.Events.size() == 2);
+        CHECK(f.Events.size() == 2 && std::abs(f.Events[1].Direction - kPi / 2) < 0.01f);
+    }
+
+    void Template()
+    {
+        MouseStrokeOptions options{};
+        options.Templates.push_back({7, {{0.0f, 0.0f}, {0.0f, 1.0f}, {0.6f, 1.0f}}}); // L
+        options.Templates.push_back({8, {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}}}); // 7
+        Fixture f(options);
+
+        // L, drawn larger and elsewhere.
+        f.Input(10000, 0, 0, RI_MOUSE_RIGHT_BUTTON_DOWN);
+        TIMESTAMP t = 10000;
+        for (int i = 0; i < 25; i++) f.Input(t += 8000, 0, 10);
+        for (int i = 0; i < 15; i++) f.Input(t += 8000, 10, 0);
+        f.Input(t += 8000, 0, 0, RI_MOUSE_RIGHT_BUTTON_UP);
+
+        CHECK(f.Events.size() == 1);
+        CHECK(!f.Events.empty() && f.Events[0].Kind == MouseStrokeKind::Template);
+        CHECK(!f.Events.empty() && f.Events[0].TemplateId == 7);
+        CHECK(!f.Events.empty() && f.Events[0].Score >= options.MinTemplateScore);
+    }
+
+    void LongStrokeKeepsItsShape()
+    {
+        // Far more motion than points: the sampling spacing doubles many times.
+        MouseStrokeOptions options{};
+        options.Templates.push_back({1, {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}}});
+        Fixture f(options);
+
+        f.Input(10000, 0, 0, RI_MOUSE_RIGHT_BUTTON_DOWN);
+        TIMESTAMP t = 10000;
+        for (int i = 0; i < 2000; i++) f.Input(t += 1000, 2, 0);
+        for (int i = 0; i < 2000; i++) f.Input(t += 1000, 0, 2);
+        f.Input(t += 1000, 0, 0, RI_MOUSE_RIGHT_BUTTON_UP);
+
+        CHECK(f.Events.size() == 1);
+        CHECK(!f.Events.empty() && f.Events[0].Kind == MouseStrokeKind::Template && f.Events[0].TemplateId == 1);
+    }
+}
+
+int main()
+{
+    Flick();
+    SlowStroke();
+    ShortStrokeIsIgnored();
+    MotionWithoutTriggerIsIgnored();
+    Circle(true);
+    Circle(false);
+    GapEndsStroke();
+    GapSeparatesStrokes();
+    Template();
+    LongStrokeKeepsItsShape();
+    return test::Result();
+}
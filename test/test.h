@@ -0,0 +1,34 @@
+/// @file
+/// @brief  Minimal checks for the librawinput tests.
+/// @author ttsuki
+
+// Licensed under the MIT License.
+// Copyright (c) 2019-2023 ttsuki All rights reserved.
+
+#pragma once
+
+#include <cstdio>
+
+namespace ttsuki::librawinput::test
+{
+    inline int& FailureCount()
+    {
+        static int count = 0;
+        return count;
+    }
+
+    /// @returns process exit code
+    inline int Result()
+    {
+        if (FailureCount() != 0) std::printf("%d check(s) failed\n", FailureCount());
+        return FailureCount() != 0 ? 1 : 0;
+    }
+}
+
+#define CHECK(expr) \
+    do { \
+        if (!(expr)) { \
+            std::printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            ::ttsuki::librawinput::test::FailureCount()++; \
+        } \
+    } while (false)
@@ -0,0 +1,129 @@
+/// @file
+/// @brief  TimerWheel tests with a virtual clock.
+/// @author ttsuki
+
+// Licensed under the MIT License.
+// Copyright (c) 2019-2023 ttsuki All rights reserved.
+
+#include "librawinput_internal.h"
+#include "test.h"
+
+#include <vector>
+
+using namespace ttsuki::librawinput;
+
+namespace
+{
+    constexpr TIMESTAMP kTick = 10000;
+
+    struct Fired
+    {
+        int Id;
+        TIMESTAMP Deadline;
+        TIMESTAMP Now;
+    };
+
+    /// Advances the wheel from `from` to `to` by `step`, and collects fired timers.
+    std::vector<Fired> Run(TimerWheel<int>& wheel, TIMESTAMP from, TIMESTAMP to, TIMESTAMP step)
+    {
+        std::vector<Fired> fired;
+        for (TIMESTAMP now = from; now <= to; now += step)
+            wheel.Advance(now, [&](int id, TIMESTAMP deadline) { fired.push_back({id, deadline, now}); });
+        return fired;
+    }
+
+    void DeadlineLaterInTheCurrentTick()
+    {
+        TimerWheel<int> wheel(kTick);
+        wheel.Schedule(15000, 1);
+
+        // The wheel passes tick 1 before the deadline.
+        CHECK(Run(wheel, 12000, 14999, 1000).empty());
+
+        const auto fired = Run(wheel, 15000, 40000, 1000);
+        CHECK(fired.size() == 1);
+        CHECK(!fired.empty() && fired[0].Now >= 15000 && fired[0].Now < 15000 + kTick);
+        CHECK(!fired.empty() && fired[0].Deadline == 15000);
+        CHECK(wheel.Empty());
+    }
+
+    void NeverBeforeDeadline()
+    {
+        TimerWheel<int> wheel(kTick);
+        for (int i = 0; i < 100; i++)
+            wheel.Schedule(1000 + i * 3333, i);
+
+        std::vector<bool> seen(100);
+        for (const Fired& f : Run(wheel, 0, 1000000, 777))
+        {
+            CHECK(f.Now >= f.Deadline);
+            CHECK(f.Now < f.Deadline + kTick + 777);
+            CHECK(!seen[f.Id]);
+            seen[f.Id] = true;
+        }
+
+        for (bool s : seen) CHECK(s);
+        CHECK(wheel.Empty());
+    }
+
+    void DeadlineBeyondARound()
+    {
+        TimerWheel<int> wheel(kTick);
+        const TIMESTAMP deadline = 64 * kTick * 3 + 5;
+        wheel.Schedule(deadline, 1);
+
+        // Its slot is visited three times before the deadline.
+        CHECK(Run(wheel, 0, deadline - 1, 7000).empty());
+        CHECK(!wheel.Empty());
+
+        const auto fired = Run(wheel, deadline, deadline + 2 * kTick, 7000);
+        CHECK(fired.size() == 1);
+        CHECK(!fired.empty() && fired[0].Now >= deadline);
+    }
+
+    void JumpOverManyTicks()
+    {
+        TimerWheel<int> wheel(kTick);
+        wheel.Schedule(25000, 1);
+        wheel.Schedule(64 * kTick + 25000, 2);
+        wheel.Schedule(1000 * kTick, 3);
+
+        std::vector<int> ids;
+        wheel.Advance(100 * kTick, [&](int id, TIMESTAMP) { ids.push_back(id); });
+        CHECK(ids.size() == 2);
+        CHECK(!wheel.Empty());
+
+        wheel.Advance(1000 * kTick, [&](int id, TIMESTAMP) { ids.push_back(id); });
+        CHECK(ids.size() == 3);
+        CHECK(wheel.Empty());
+    }
+
+    void ScheduleFromCallback()
+    {
+        TimerWheel<int> wheel(kTick);
+        wheel.Schedule(5000, 1);
+
+        std::vector<Fired> fired;
+        for (TIMESTAMP now = 0; now <= 100000; now += 1000)
+        {
+            wheel.Advance(now, [&](int id, TIMESTAMP deadline)
+            {
+                fired.push_back({id, deadline, now});
+                if (id == 1) wheel.Schedule(now + 30000, 2);
+            });
+        }
+
+        CHECK(fired.size() == 2);
+        CHECK(fired.size() == 2 && fired[1].Id == 2 && fired[1].Now >= fired[0].Now + 30000);
+    }
+}
+
+int main()
+{
+    DeadlineLaterInTheCurrentTick();
+    NeverBeforeDeadline();
+    DeadlineBeyondARound();
+    JumpOverManyTicks();
+    ScheduleFromCallback();
+    return test::Result();
+}
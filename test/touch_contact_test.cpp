@@ -0,0 +1,161 @@
+/// @file
+/// @brief  TouchContactTracker tests with injected reports.
+/// @author ttsuki
+
+// Licensed under the MIT License.
+// Copyright (c) 2019-2023 ttsuki All rights reserved.
+
+#include "librawinput_internal.h"
+#include "test.h"
+
+#include <initializer_list>
+#include <vector>
+
+using namespace ttsuki::librawinput;
+
+namespace
+{
+    const HANDLE kDevice = reinterpret_cast<HANDLE>(1);
+
+    struct Contact
+    {
+        uint32_t Id;
+        bool Tip;
+    };
+
+    /// @param contact_count contact count of the frame in its first report, 0 in continuation reports
+    TouchReport Report(uint32_t contact_count, std::initializer_list<Contact> contacts)
+    {
+        TouchReport r{};
+        r.ContactCount = contact_count;
+        for (const Contact& c : contacts)
+        {
+            TouchContact t{};
+            t.ContactId = c.Id;
+            t.X = static_cast<float>(c.Id) * 0.1f;
+            t.Y = 0.5f;
+            r.Contacts.push_back({t, c.Tip});
+        }
+        return r;
+    }
+
+    class Fixture
+    {
+        TouchContactTracker tracker_{};
+        TIMESTAMP now_{};
+
+    public:
+        std::vector<TouchEvent> Events{};
+
+        void Feed(const TouchReport& report)
+        {
+            tracker_.Feed(kDevice, now_ += 8000, report, [this](const TouchEvent& e) { Events.push_back(e); });
+        }
+
+        /// @returns count of contacts of the phase in all events
+        [[nodiscard]] size_t Count(TouchContactPhase phase) const
+        {
+            size_t n = 0;
+            for (const TouchEvent& e : Events)
+                for (const TouchContact& c : e.Contacts)
+                    n += c.Phase == phase;
+            return n;
+        }
+    };
+
+    void SingleReportFrames()
+    {
+        Fixture f;
+        f.Feed(Report(2, {{1, true}, {2, true}}));
+        f.Feed(Report(2, {{1, true}, {2, true}}));
+        f.Feed(Report(2, {{1, true}, {2, false}}));
+        f.Feed(Report(1, {{1, false}}));
+
+        CHECK(f.Events.size() == 4);
+        CHECK(f.Count(TouchContactPhase::Down) == 2);
+        CHECK(f.Count(TouchContactPhase::Move) == 3);
+        CHECK(f.Count(TouchContactPhase::Up) == 2);
+    }
+
+    void HybridFrame()
+    {
+        // A frame of four contacts in two reports is delivered once.
+        Fixture f;
+        f.Feed(Report(4, {{1, true}, {2, true}}));
+        CHECK(f.Events.empty());
+        f.Feed(Report(0, {{3, true}, {4, true}}));
+
+        CHECK(f.Events.size() == 1);
+        CHECK(!f.Events.empty() && f.Events[0].Contacts.size() == 4);
+        CHECK(f.Count(TouchContactPhase::Down) == 4);
+    }
+
+    void MissingContactIsLifted()
+    {
+        Fixture f;
+        f.Feed(Report(2, {{1, true}, {2, true}}));
+        f.Feed(Report(1, {{1, true}})); // contact 2 is gone without a report of lifting
+
+        CHECK(f.Count(TouchContactPhase::Up) == 1);
+        CHECK(f.Events.size() == 2 && f.Events[1].Contacts.size() == 2);
+    }
+
+    void LostContinuationReport()
+    {
+        Fixture f;
+        f.Feed(Report(4, {{1, true}, {2, true}}));
+        f.Feed(Report(0, {{3, true}, {4, true}}));
+
+        // The continuation report of this frame is lost.
+        f.Feed(Report(4, {{1, true}, {2, true}}));
+
+        f.Feed(Report(4, {{1, true}, {2, true}}));
+        f.Feed(Report(0, {{3, true}, {4, true}}));
+
+        // Contacts 3 and 4 are neither lifted nor touched again.
+        CHECK(f.Count(TouchContactPhase::Down) == 4);
+        CHECK(f.Count(TouchContactPhase::Up) == 0);
+        CHECK(f.Events.size() == 3);
+        CHECK(f.Events.size() == 3 && f.Events[1].Contacts.size() == 2);
+        CHECK(f.Events.size() == 3 && f.Events[2].Contacts.size() == 4);
+    }
+
+    void LostFirstReport()
+    {
+        Fixture f;
+        f.Feed(Report(4, {{1, true}, {2, true}}));
+        f.Feed(Report(0, {{3, true}, {4, true}}));
+
+        // The first report of this frame is lost: its continuation is not a frame.
+        f.Feed(Report(0, {{3, true}, {4, true}}));
+        CHECK(f.Events.size() == 1);
+
+        f.Feed(Report(4, {{1, true}, {2, true}}));
+        f.Feed(Report(0, {{3, true}, {4, true}}));
+
+        CHECK(f.Events.size() == 2);
+        CHECK(f.Count(TouchContactPhase::Down) == 4);
+        CHECK(f.Count(TouchContactPhase::Move) == 4);
+        CHECK(f.Count(TouchContactPhase::Up) == 0);
+    }
+
+    void EmptyReportLiftsAll()
+    {
+        Fixture f;
+        f.Feed(Report(2, {{1, true}, {2, true}}));
+        f.Feed(Report(0, {}));
+
+        CHECK(f.Count(TouchContactPhase::Up) == 2);
+    }
+}
+
+int main()
+{
+    SingleReportFrames();
+    HybridFrame();
+    MissingContactIsLifted();
+    LostContinuationReport();
+    LostFirstReport();
+    EmptyReportLiftsAll();
+    return test::Result();
+}
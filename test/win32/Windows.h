@@ -0,0 +1,127 @@
+/// @file
+/// @brief  Win32 declarations used by the portable parts of librawinput, for building the tests on other hosts.
+///         Layouts follow the Windows SDK; only what the tests need is declared.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define WINAPI
+
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short USHORT, WORD, USAGE;
+typedef unsigned int UINT;
+typedef uint32_t ULONG, DWORD;
+typedef int32_t LONG;
+typedef char CHAR, *PCHAR;
+typedef wchar_t WCHAR, *LPWSTR;
+typedef uintptr_t ULONG_PTR, DWORD_PTR, WPARAM;
+typedef intptr_t LONG_PTR, LPARAM, LRESULT;
+typedef void* HANDLE;
+struct HWND__;
+typedef HWND__* HWND;
+struct HRAWINPUT__;
+typedef HRAWINPUT__* HRAWINPUT;
+
+#define THREAD_PRIORITY_HIGHEST 2
+
+#define VK_CANCEL 0x03
+#define VK_RETURN 0x0D
+#define VK_SHIFT 0x10
+#define VK_CONTROL 0x11
+#define VK_MENU 0x12
+#define VK_PAUSE 0x13
+#define VK_ESCAPE 0x1B
+#define VK_HOME 0x24
+#define VK_UP 0x26
+#define VK_LWIN 0x5B
+#define VK_NUMPAD7 0x67
+#define VK_NUMPAD8 0x68
+#define VK_DIVIDE 0x6F
+#define VK_NUMLOCK 0x90
+#define VK_LSHIFT 0xA0
+#define VK_RSHIFT 0xA1
+#define VK_LCONTROL 0xA2
+#define VK_RCONTROL 0xA3
+#define VK_LMENU 0xA4
+#define VK_RMENU 0xA5
+
+#define RI_KEY_MAKE 0
+#define RI_KEY_BREAK 1
+#define RI_KEY_E0 2
+#define RI_KEY_E1 4
+#define KEYBOARD_OVERRUN_MAKE_CODE 0xFF
+
+#define RI_MOUSE_LEFT_BUTTON_DOWN 0x0001
+#define RI_MOUSE_LEFT_BUTTON_UP 0x0002
+#define RI_MOUSE_RIGHT_BUTTON_DOWN 0x0004
+#define RI_MOUSE_RIGHT_BUTTON_UP 0x0008
+#define RI_MOUSE_MIDDLE_BUTTON_DOWN 0x0010
+#define RI_MOUSE_MIDDLE_BUTTON_UP 0x0020
+#define RI_MOUSE_BUTTON_4_DOWN 0x0040
+#define RI_MOUSE_BUTTON_4_UP 0x0080
+#define RI_MOUSE_BUTTON_5_DOWN 0x0100
+#define RI_MOUSE_BUTTON_5_UP 0x0200
+#define RI_MOUSE_WHEEL 0x0400
+#define RI_MOUSE_HWHEEL 0x0800
+#define MOUSE_MOVE_RELATIVE 0
+#define MOUSE_MOVE_ABSOLUTE 1
+#define WHEEL_DELTA 120
+
+struct RAWINPUTHEADER
+{
+    DWORD dwType;
+    DWORD dwSize;
+    HANDLE hDevice;
+    WPARAM wParam;
+};
+
+struct RAWMOUSE
+{
+    USHORT usFlags;
+    union
+    {
+        ULONG ulButtons;
+        struct
+        {
+            USHORT usButtonFlags;
+            USHORT usButtonData;
+        };
+    };
+    ULONG ulRawButtons;
+    LONG lLastX;
+    LONG lLastY;
+    ULONG ulExtraInformation;
+};
+
+struct RAWKEYBOARD
+{
+    USHORT MakeCode;
+    USHORT Flags;
+    USHORT Reserved;
+    USHORT VKey;
+    UINT Message;
+    ULONG ExtraInformation;
+};
+
+struct RAWHID
+{
+    DWORD dwSizeHid;
+    DWORD dwCount;
+    BYTE bRawData[1];
+};
+
+struct RAWINPUT
+{
+    RAWINPUTHEADER header;
+    union
+    {
+        RAWMOUSE mouse;
+        RAWKEYBOARD keyboard;
+        RAWHID hid;
+    } data;
+};
+
+int WINAPI ToUnicode(UINT vkey, UINT scan_code, const BYTE* key_state, LPWSTR buffer, int buffer_size, UINT flags);